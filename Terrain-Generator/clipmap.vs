@@ -0,0 +1,65 @@
+#version 330 core
+out vec3 Normal;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+// One layer per clipmap level: height and normal of lattice point (x, z) at texel
+// (x & textureMask, z & textureMask), see geometry_clipmap.h
+uniform sampler2DArray heightmap;
+uniform int textureMask;
+uniform int level;
+uniform int gridSize;           // Vertices per grid side
+uniform ivec2 windowOrigin;     // Lattice index of vertex (0, 0), in the level's spacing
+uniform float levelSpacing;
+uniform vec2 latticeOrigin;     // World x/z of lattice point (0, 0)
+
+// Over the last transitionWidth vertices before its outer edge a level blends into the next
+// coarser one, so its edge vertices lie on the coarser ring's triangles and nothing cracks
+uniform bool blendCoarser;
+uniform float transitionWidth;
+
+vec4 latticeTexel(ivec2 point, int layer)
+{
+    return texelFetch(heightmap, ivec3(point & textureMask, layer), 0);
+}
+
+void main()
+{
+    ivec2 local = ivec2(gl_VertexID % gridSize, gl_VertexID / gridSize);
+    ivec2 point = windowOrigin + local;
+    vec4 texel = latticeTexel(point, level);
+
+    if (blendCoarser) {
+        float halfGrid = float(gridSize - 1) * 0.5;
+        vec2 fromCentre = abs(vec2(local) - vec2(halfGrid));
+        float alpha = clamp((max(fromCentre.x, fromCentre.y) - (halfGrid - transitionWidth - 1.0)) / transitionWidth, 0.0, 1.0);
+        if (alpha > 0.0) {
+            // The coarser surface here: its own vertex on even points, otherwise the middle of
+            // the edge or quad diagonal (top right to bottom left) the point lies on
+            ivec2 odd = point & 1;
+            ivec2 a = point, b = point;
+            if (odd.x == 1 && odd.y == 1) {
+                a = point + ivec2(1, -1);
+                b = point + ivec2(-1, 1);
+            }
+            else if (odd.x == 1) {
+                a = point - ivec2(1, 0);
+                b = point + ivec2(1, 0);
+            }
+            else if (odd.y == 1) {
+                a = point - ivec2(0, 1);
+                b = point + ivec2(0, 1);
+            }
+            vec4 coarse = 0.5 * (latticeTexel(a >> 1, level + 1) + latticeTexel(b >> 1, level + 1));
+            // Exactly the coarse value on the edge itself, mix() may round
+            texel = alpha < 1.0 ? mix(texel, coarse, alpha) : coarse;
+        }
+    }
+
+    vec3 pos = vec3(latticeOrigin.x + float(point.x) * levelSpacing, texel.x, latticeOrigin.y + float(point.y) * levelSpacing);
+    // model is only ever a translation, so it leaves normals alone
+    Normal = mat3(model) * texel.yzw;
+    gl_Position = projection * view * model * vec4(pos, 1.0);
+}
@@ -10,6 +10,14 @@
 #include <shader_m.h>
 #include <iostream>
 #include "noise.h"
+#include "terrain_mesh.h"
+#include "chunk_manager.h"
+#include "chunk_lod.h"
+#include "lod_terrain.h"
+#include "geometry_clipmap.h"
+#include "tessellated_terrain.h"
+#include "tessellation_smoke_test.h"
+#include <cstring>
 #include <vector>
 
     // Callback to resize the viewport
@@ -32,8 +40,23 @@
     }
 
     // ImGui variables
-    int CHUNK_COUNT = 16;
-    int GRID_SIZE = 4;
+    int viewRadius = 2;         // Chunks kept loaded around the camera
+    int chunkBudgetMB = 64;     // Cache limit for chunks that have left the view ring
+    float uploadBudgetMs = 2.0f; // GL upload time per frame for finished chunks
+    bool useDiskCache = false;  // Keep generated noise fields on disk between sessions
+    // What draws the terrain: the chunk ring, the CDLOD quadtree out to the view distance, the
+    // geometry clipmap, or patches tessellated on the GPU (OpenGL 4.0 contexts only)
+    enum class TerrainRenderer { Chunks, Lod, Clipmap, Tessellated };
+    int terrainRenderer = (int)TerrainRenderer::Chunks;
+    float lodViewDistance = 2000.0f;
+    int lodNodeQuadsLog2 = 5;   // Quads per LOD node side, 32
+    std::string diskCacheDir = "terrain_cache";
+    char diskCacheDirInput[256] = "terrain_cache";
+    int diskCacheBudgetMB = 512;    // Oldest cached fields are deleted past this
+    // Terrain recipe replacing the fBm sliders while loaded, see noise_graph.h
+    char recipePathInput[256] = "terrain.recipe";
+    std::shared_ptr<const NoiseGraph> recipe;
+    std::string recipeStatus;
     int octaves = 4;
     float persistence = 0.5f;
     int width = 32;
@@ -41,9 +64,82 @@
     float frequency = 2.0f;
     int scale = 50;
     float heightScale = 10.0f;
+    int worldSeed = 1337;       // Same seed, same world: chunks can be cached and generated in any order
+    bool edgeFalloff = true;
+    bool octaveCulling = false;
+    float cullTolerance = 0.05f;
+    bool coarseOctaves = false;
+    float coarseTolerance = 0.02f;
     float lacunarity = 2.0f;
-
-    bool terrainNeedsUpdate = false; //update whenever changes in noise function
+    int noiseMode = (int)NoiseMode::Perlin3D;
+    int fractalType = (int)FractalType::Fbm;
+    int generationThreads = defaultThreadCount();
+    int vertexFormat = (int)VertexFormat::Position3f;
+    bool useTriangleStrips = false;
+    float meshTolerance = 0.0f; // Height error adaptive chunk meshes may leave, 0 draws full grids
+    int chunkLodLevels = 1;     // Detail levels across the chunk ring, 1 draws every chunk in full
+    int chunkLodRings = 1;      // Rings of chunks around the camera per level
+    bool chunkSkirts = false;   // Hide the cracks between levels with skirts instead of stitched edges
+    bool wireframe = true;
+
+    // Timing of the last full terrain regeneration, shown in the menu. Chunks generate in the
+    // background, so this is the time from the change until the whole view ring is refreshed.
+    double lastRegenMs = 0.0;
+    double lastRegenSamples = 0.0;
+    double regenStart = -1.0;   // Set while a regeneration is in progress
+    RegenStage lastRegenStage = RegenStage::None;
+
+
+    // Loaded chunk count and memory, shown in the menu
+    size_t loadedChunks = 0;
+    size_t loadedChunkBytes = 0;
+    int chunkJobsRunning = 0;
+    int chunkJobsCancelled = 0;
+    double chunkBorderReuse = 0.0;
+    int chunkOctavesFewest = 0;
+    double chunkOctaveEvaluations = 0.0;
+    int chunkOctavesMost = 0;
+    size_t chunkTriangles = 0;          // Drawn by the visible chunks
+    size_t chunkFullGridTriangles = 0;  // The same chunks as full grids
+    int diskCacheHits = 0;
+    int diskCacheWrites = 0;
+    double diskCacheBytes = 0.0;
+    size_t lodNodesDrawn = 0;
+    size_t lodTriangles = 0;
+    int lodJobsRunning = 0;
+    int clipmapLevels = 8;
+    size_t clipmapTriangles = 0;
+    size_t clipmapSamplesUpdated = 0;   // Lattice points generated last frame
+    float tessTriangleSize = 12.0f;     // Screen-space edge length tessellation aims for, in pixels
+    int tessTextureSizeLog2 = 9;
+    int tessPatchQuadsLog2 = 4;         // Lattice quads per patch side, 16
+    int tessPatches = 0;
+    size_t tessTriangles = 0;
+    size_t tessSamplesUpdated = 0;
+    double noiseBenchmark[NOISE_MODE_COUNT] = {};  // Samples/s per noise backend, 0 until benchmarked
+
+    TerrainSettings currentTerrainSettings() {
+        TerrainSettings settings;
+        settings.width = width;
+        settings.height = height;
+        settings.scale = (float)scale;
+        settings.seed = (float)worldSeed;
+        settings.octaves = octaves;
+        settings.persistence = persistence;
+        settings.frequency = frequency;
+        settings.lacunarity = lacunarity;
+        settings.heightScale = heightScale;
+        settings.falloff = edgeFalloff;
+        settings.octaveCulling = octaveCulling;
+        settings.cullTolerance = cullTolerance;
+        settings.coarseOctaves = coarseOctaves;
+        settings.coarseTolerance = coarseTolerance;
+        settings.mode = (NoiseMode)noiseMode;
+        settings.fractal = (FractalType)fractalType;
+        settings.format = (VertexFormat)vertexFormat;
+        settings.recipe = recipe;
+        return settings;
+    }
 
     void renderImGuiMenu() {
         if (!isGuiOpen) return;  // Don't render if menu is closed
@@ -54,15 +150,9 @@
 
         ImGui::Begin("Settings Menu");
 
-        int oldoctaves = octaves;
-        int oldwidth = width;
-        int oldheight = height;
-        float oldfrequency = frequency;
-        int oldscale = scale;
-        float oldpersistence = persistence;
-        float oldheightscale = heightScale;
-        float oldLacunarity = lacunarity;
-
+        if (ImGui::InputInt("Seed", &worldSeed)) {
+            worldSeed = std::min(std::max(worldSeed, 0), MAX_WORLD_SEED);
+        }
         ImGui::SliderFloat("Persistence", &persistence, 0.0f, 1.0f);
         ImGui::SliderInt("Octaves", &octaves, 0, 10);
         ImGui::SliderInt("Width", &width, 0, 1000);
@@ -71,9 +161,93 @@
         ImGui::SliderInt("Scale", &scale, 0, 100);
         ImGui::SliderFloat("Lacunarity", &lacunarity, 0.0f, 5.0f);
         ImGui::SliderFloat("Height Scale", &heightScale, 0.0f, 50.0f);
-        if (oldpersistence != persistence || oldoctaves != octaves ||
-            oldwidth != width || oldheight != height || oldfrequency != frequency || oldscale != scale || oldLacunarity != lacunarity || oldheightscale != heightScale) {
-            terrainNeedsUpdate = true;
+        ImGui::Checkbox("Edge Falloff", &edgeFalloff);
+        ImGui::Checkbox("Octave Culling", &octaveCulling);
+        if (octaveCulling) ImGui::SliderFloat("Cull Tolerance", &cullTolerance, 0.0f, 1.0f);
+        ImGui::Checkbox("Coarse Octaves", &coarseOctaves);
+        if (coarseOctaves) ImGui::SliderFloat("Coarse Tolerance", &coarseTolerance, 0.001f, 0.5f);
+        const char* noiseModes[NOISE_MODE_COUNT];
+        for (int m = 0; m < NOISE_MODE_COUNT; m++) noiseModes[m] = noiseModeName((NoiseMode)m);
+        ImGui::Combo("Noise Mode", &noiseMode, noiseModes, NOISE_MODE_COUNT);
+        const char* fractalTypes[FRACTAL_TYPE_COUNT];
+        for (int f = 0; f < FRACTAL_TYPE_COUNT; f++) fractalTypes[f] = fractalTypeName((FractalType)f);
+        ImGui::Combo("Fractal", &fractalType, fractalTypes, FRACTAL_TYPE_COUNT);
+        ImGui::InputText("Recipe", recipePathInput, sizeof(recipePathInput));
+        if (ImGui::Button("Load Recipe")) {
+            // A new graph object every load, so editing the file and loading again regenerates
+            std::shared_ptr<NoiseGraph> graph = std::make_shared<NoiseGraph>();
+            std::string error;
+            if (loadNoiseGraph(recipePathInput, *graph, error)) {
+                recipe = graph;
+                recipeStatus = std::string("Loaded ") + recipePathInput;
+            }
+            else {
+                recipeStatus = error;
+            }
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Clear Recipe")) {
+            recipe.reset();
+            recipeStatus.clear();
+        }
+        if (!recipeStatus.empty()) ImGui::TextWrapped("%s", recipeStatus.c_str());
+        ImGui::SliderInt("Threads", &generationThreads, 1, defaultThreadCount()); // Chunks generated at once
+        const char* vertexFormats[] = { vertexFormatName(VertexFormat::Position3f), vertexFormatName(VertexFormat::HeightFloat), vertexFormatName(VertexFormat::HeightUnorm16), vertexFormatName(VertexFormat::PositionNormal3f) };
+        ImGui::Combo("Vertex Format", &vertexFormat, vertexFormats, IM_ARRAYSIZE(vertexFormats));
+        ImGui::Checkbox("Triangle Strips", &useTriangleStrips);
+        // Adaptive meshes are triangle lists, strips only apply to full grids
+        ImGui::SliderFloat("Mesh Tolerance", &meshTolerance, 0.0f, 2.0f, "%.3f");
+        if (meshTolerance > 0.0f && !rtinGridFits(width, height)) ImGui::TextWrapped("Adaptive meshes need square chunks of 2^k + 1 vertices, e.g. 33 or 65");
+        // Chunk levels of detail are triangle lists too, and give way to adaptive meshes
+        ImGui::SliderInt("Chunk LOD Levels", &chunkLodLevels, 1, 6);
+        ImGui::SliderInt("Chunk LOD Rings", &chunkLodRings, 1, 4);
+        ImGui::Checkbox("Chunk Skirts", &chunkSkirts);
+        ImGui::Checkbox("Wireframe", &wireframe); // Off to see the lit vertex format shaded
+        ImGui::SliderInt("View Radius", &viewRadius, 0, 8);
+        ImGui::SliderInt("Chunk Budget (MB)", &chunkBudgetMB, 1, 1024);
+        ImGui::SliderFloat("Upload Budget (ms)", &uploadBudgetMs, 0.0f, 16.0f);
+        ImGui::Checkbox("Disk Cache", &useDiskCache);
+        // Applied on Enter so typing a path doesn't create every prefix of it
+        if (ImGui::InputText("Cache Directory", diskCacheDirInput, sizeof(diskCacheDirInput), ImGuiInputTextFlags_EnterReturnsTrue)) {
+            diskCacheDir = diskCacheDirInput;
+        }
+        ImGui::SliderInt("Disk Cache Budget (MB)", &diskCacheBudgetMB, 16, 8192);
+
+        ImGui::Text("Last regen (%s): %.1f ms, %.1f M noise samples/s (%s)", regenStageName(lastRegenStage), lastRegenMs,
+            lastRegenMs > 0.0 ? lastRegenSamples / (lastRegenMs * 1000.0) : 0.0, simdLevelName(activeSimdLevel()));
+        ImGui::Text("Chunks: %d loaded, %.1f MB, %d jobs running, %d cancelled", (int)loadedChunks, loadedChunkBytes / (1024.0 * 1024.0),
+            chunkJobsRunning, chunkJobsCancelled);
+        ImGui::Text("Chunk triangles: %d (%.1f%% of full grids)", (int)chunkTriangles,
+            chunkFullGridTriangles > 0 ? 100.0 * chunkTriangles / chunkFullGridTriangles : 100.0);
+        ImGui::Text("Octaves per chunk: %d-%d of %d", chunkOctavesFewest, chunkOctavesMost, recipe ? recipe->octaves : octaves);
+        ImGui::Text("Octave evaluations per vertex: %.2f", chunkOctaveEvaluations);
+        ImGui::Text("Border reuse: %.1f%% of noise samples", chunkBorderReuse * 100.0);
+        if (useDiskCache) ImGui::Text("Disk cache: %d hits, %d writes, %.1f of %d MB", diskCacheHits, diskCacheWrites,
+            diskCacheBytes / (1024.0 * 1024.0), diskCacheBudgetMB);
+        const char* terrainRenderers[] = { "Chunks", "LOD Terrain (CDLOD)", "Geometry Clipmap", "Tessellated (GPU)" };
+        ImGui::Combo("Renderer", &terrainRenderer, terrainRenderers, IM_ARRAYSIZE(terrainRenderers) - (tessellationSupported() ? 0 : 1));
+        if (terrainRenderer == (int)TerrainRenderer::Lod) {
+            ImGui::SliderFloat("View Distance", &lodViewDistance, 100.0f, 20000.0f, "%.0f");
+            ImGui::SliderInt("Node Quads (log2)", &lodNodeQuadsLog2, 3, 7);
+            ImGui::Text("LOD: %d nodes, %.2f M triangles, %d jobs running", (int)lodNodesDrawn, lodTriangles / 1e6, lodJobsRunning);
+        }
+        if (terrainRenderer == (int)TerrainRenderer::Clipmap) {
+            ImGui::SliderInt("Clipmap Levels", &clipmapLevels, 1, 12);
+            ImGui::Text("Clipmap: %.2f M triangles, %d samples updated", clipmapTriangles / 1e6, (int)clipmapSamplesUpdated);
+        }
+        if (terrainRenderer == (int)TerrainRenderer::Tessellated) {
+            ImGui::SliderFloat("Triangle Size (px)", &tessTriangleSize, 2.0f, 64.0f, "%.1f");
+            ImGui::SliderInt("Heightmap Size (log2)", &tessTextureSizeLog2, 8, 11);
+            ImGui::SliderInt("Patch Quads (log2)", &tessPatchQuadsLog2, 2, 6);
+            ImGui::Text("Tessellation: %d patches, %.2f M triangles, %d samples updated", tessPatches, tessTriangles / 1e6, (int)tessSamplesUpdated);
+        }
+
+        // Blocks the frame for a fraction of a second per backend
+        if (ImGui::Button("Benchmark Noise")) {
+            for (int m = 0; m < NOISE_MODE_COUNT; m++) noiseBenchmark[m] = noiseSamplesPerSecond(activeSimdLevel(), (NoiseMode)m, 0.1);
+        }
+        for (int m = 0; m < NOISE_MODE_COUNT; m++) {
+            if (noiseBenchmark[m] > 0.0) ImGui::Text("%s: %.1f M samples/s", noiseModeName((NoiseMode)m), noiseBenchmark[m] / 1e6);
         }
 
         ImGui::End();
@@ -168,20 +342,30 @@
         cameraFront = glm::normalize(front);
     }
 
-    int main() {
+    // --headless-test renders one tessellated frame offscreen in a hidden window and exits,
+    // non-zero if it fails; CI runs it under Mesa llvmpipe
+    int main(int argc, char** argv) {
+        bool headlessTest = argc > 1 && std::strcmp(argv[1], "--headless-test") == 0;
+
         // Initialize GLFW
         if (!glfwInit()) {
             std::cerr << "Failed to initialize GLFW" << std::endl;
             return -1;
         }
 
-        // Set OpenGL version to 3.3 Core Profile
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        // OpenGL 4.1 Core Profile for the tessellated renderer, 3.3 where that's not available
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
         glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        if (headlessTest) glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
         // Create a window
         GLFWwindow* window = glfwCreateWindow(800, 600, "Terrain Renderer", nullptr, nullptr);
+        if (!window) {
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+            window = glfwCreateWindow(800, 600, "Terrain Renderer", nullptr, nullptr);
+        }
         if (!window) {
             std::cerr << "Failed to create GLFW window" << std::endl;
             glfwTerminate();
@@ -195,6 +379,12 @@
             return -1;
         }
 
+        if (headlessTest) {
+            bool passed = runTessellationSmokeTest();
+            glfwTerminate();
+            return passed ? 0 : 1;
+        }
+
         // Set the viewport and callback
         glViewport(0, 0, 800, 600);
         glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
@@ -261,81 +451,29 @@
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 
-        float seed;
-
+        // All chunks share one index buffer per grid size
+        IndexBufferCache indexCache;
+        ChunkLodIndices chunkLodIndices;    // Every level and edge variant for the current grid size
 
-        struct TerrainChunk {
-            unsigned int VAO, VBO, EBO;
-            TerrainData terrain;
-            float xOffset, zOffset;
-        };
-        
-        std::vector<TerrainChunk> chunkList;
-        unsigned int zOffset = 0;
-        for (int i = 0; i < CHUNK_COUNT; i++) {
-            seed = glfwGetTime();
-            TerrainChunk chunk;
-
-            // Calculate grid position
-            int gridX = i % GRID_SIZE;
-            int gridZ = i / GRID_SIZE;
-
-            // Calculate world position
-            chunk.xOffset = gridX * (width - 1); // Correct for overlap
-            chunk.zOffset = gridZ * (height - 1); // Correct for overlap
-
-
-            // Generate terrain data first
-            chunk.terrain = generateTerrain(width, height, scale, seed, octaves,
-                persistence, frequency, lacunarity, heightScale, chunk.xOffset, chunk.zOffset);
-
-            //// set position of terrain data according to grid position
-            //for (int i = 0; i < chunk.terrain.vertices.size(); i++)
-            //{
-            //    if (i % 3 == 0)
-            //        chunk.terrain.vertices.at(i) += chunk.xOffset;
-            //    if (i % 3 == 2)
-            //        chunk.terrain.vertices.at(i) += chunk.zOffset;
-            //}
-            // Create OpenGL buffers
-            glGenVertexArrays(1, &chunk.VAO);
-            glGenBuffers(1, &chunk.VBO);
-            glGenBuffers(1, &chunk.EBO);
-
-            // Bind and setup VAO/VBO
-            glBindVertexArray(chunk.VAO);
-            glBindBuffer(GL_ARRAY_BUFFER, chunk.VBO);
-            glBufferData(GL_ARRAY_BUFFER,
-                chunk.terrain.vertices.size() * sizeof(float),
-                chunk.terrain.vertices.data(),
-                GL_STATIC_DRAW);
-
-            // Setup indices
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk.EBO);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                chunk.terrain.indices.size() * sizeof(unsigned int),
-                chunk.terrain.indices.data(),
-                GL_STATIC_DRAW);
-
-            // Setup vertex attributes
-            glEnableVertexAttribArray(0);
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-
-            // Add to list
-            chunkList.push_back(chunk);
-        }
+        // Chunks are loaded around the camera as it moves, starting with the first frame
+        ChunkManager chunkManager;
+        LodTerrain lodTerrain;      // Replace the chunks when selected
+        GeometryClipmap clipmap;
+        TessellatedTerrain tessellatedTerrain;
+        TerrainSettings appliedSettings = currentTerrainSettings(); // What the chunks were last asked to match
 
         // Shader setup (place the shaders in the same directory)
         Shader shader("shader.vs", "shader.fs");
         Shader noiseshader("noiseshader.vs", "noiseshader.fs");
+        Shader clipmapShader("clipmap.vs", "noiseshader.fs");
+        std::unique_ptr<Shader> tessellationShader;
+        if (tessellationSupported()) tessellationShader = std::make_unique<Shader>("tessellation.vs", "tessellation.tcs", "tessellation.tes", "noiseshader.fs");
         // Background color
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 
         // Register mouse callback
         glfwSetCursorPosCallback(window, mouse_callback);
 
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-
         initImGui(window);
 
         // Render loop
@@ -350,6 +488,7 @@
 
             // Clear the screen
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glPolygonMode(GL_FRONT_AND_BACK, wireframe ? GL_LINE : GL_FILL);
 
             // Use the shader and draw the cube
             shader.use();
@@ -360,7 +499,25 @@
             glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
 
             // Projection matrix (perspective projection)
+            // LOD terrain and the clipmap reach far past the chunk ring, the far plane follows them
+            TerrainSettings settings = currentTerrainSettings();
+            TerrainRenderer renderer = (TerrainRenderer)terrainRenderer;
+            lodTerrain.viewDistance = lodViewDistance;
+            lodTerrain.quads = 1 << lodNodeQuadsLog2;
+            clipmap.levels = clipmapLevels;
+            tessellatedTerrain.textureSizeLog2 = tessTextureSizeLog2;
+            tessellatedTerrain.patchQuads = 1 << tessPatchQuadsLog2;
+            tessellatedTerrain.triangleSize = tessTriangleSize;
             glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+            if (renderer == TerrainRenderer::Lod) {
+                projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.5f, lodTerrain.farDistance(settings));
+            }
+            else if (renderer == TerrainRenderer::Clipmap) {
+                projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.5f, clipmap.farDistance(settings));
+            }
+            else if (renderer == TerrainRenderer::Tessellated) {
+                projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.5f, tessellatedTerrain.farDistance(settings));
+            }
             GLint projLoc = glGetUniformLocation(shader.ID, "projection");
             glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
 
@@ -373,34 +530,96 @@
             glBindVertexArray(cubeVAO);
             glDrawArrays(GL_TRIANGLES, 0, 36);
 
-            // Update terrain if needed
-            if (terrainNeedsUpdate) {
-                for (int i = 0; i < chunkList.size(); i++) {
-                    float seed = glfwGetTime();
-                    TerrainChunk chunk = chunkList[i];
-                    // Calculate grid position
-                    int gridX = i % GRID_SIZE;
-                    int gridZ = i / GRID_SIZE;
-
-                    // Calculate world position
-                    chunk.xOffset = gridX * (width - 1); // Correct for overlap
-                    chunk.zOffset = gridZ * (height - 1); // Correct for overlap
-
-                    chunk.terrain = generateTerrain(width, height, scale, seed, octaves, persistence, frequency, lacunarity, heightScale, chunk.xOffset, chunk.zOffset);
-
-                    glBindBuffer(GL_ARRAY_BUFFER, chunk.VBO);
-                    glBufferData(GL_ARRAY_BUFFER,
-                        chunk.terrain.vertices.size() * sizeof(float),
-                        chunk.terrain.vertices.data(),
-                        GL_DYNAMIC_DRAW);
-
-                    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk.EBO);
-                    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                        chunk.terrain.indices.size() * sizeof(unsigned int),
-                        chunk.terrain.indices.data(),
-                        GL_DYNAMIC_DRAW);
+            chunkManager.viewRadius = viewRadius;
+            chunkManager.memoryBudget = (size_t)chunkBudgetMB * 1024 * 1024;
+            chunkManager.maxJobsInFlight = generationThreads;
+            chunkManager.uploadBudgetMs = uploadBudgetMs;
+            chunkManager.meshTolerance = meshTolerance;
+            uint64_t diskCacheBudget = (uint64_t)diskCacheBudgetMB * 1024 * 1024;
+            ChunkDiskCache* diskCache = chunkManager.diskCacheInUse();
+            if (useDiskCache && (!diskCache || diskCache->path() != diskCacheDir)) {
+                chunkManager.setDiskCache(std::make_shared<ChunkDiskCache>(diskCacheDir, diskCacheBudget));
+            }
+            else if (!useDiskCache && diskCache) {
+                chunkManager.setDiskCache(nullptr);
+            }
+            else if (diskCache) {
+                diskCache->setMaxBytes(diskCacheBudget);
+            }
+
+            // Update terrain if needed, redoing only the stages the changed settings feed into
+            RegenStage stage = regenStageFor(appliedSettings, settings);
+            if (stage != RegenStage::None) {
+                regenStart = glfwGetTime();
+                lastRegenStage = stage;
+                // All of them, so whichever is off is up to date when it's switched back on
+                chunkManager.regenerate(stage);
+                lodTerrain.regenerate();
+                clipmap.regenerate();
+                tessellatedTerrain.regenerate();
+                appliedSettings = settings;
+            }
+
+            // Upload finished chunks and start generating the ones the camera needs
+            if (renderer == TerrainRenderer::Lod) {
+                lodTerrain.maxJobsInFlight = generationThreads;
+                lodTerrain.memoryBudget = (size_t)chunkBudgetMB * 1024 * 1024;
+                lodTerrain.uploadBudgetMs = uploadBudgetMs;
+                lodTerrain.update(settings, cameraPos);
+                lodNodesDrawn = lodTerrain.nodesSelected();
+                lodTriangles = lodTerrain.trianglesSelected();
+                lodJobsRunning = lodTerrain.jobsRunning();
+                if (regenStart >= 0.0 && lodTerrain.upToDate()) {
+                    lastRegenMs = (glfwGetTime() - regenStart) * 1000.0;
+                    lastRegenSamples = 0.0;
+                    regenStart = -1.0;
+                }
+            }
+            else if (renderer == TerrainRenderer::Clipmap) {
+                // Generates what the camera moved into right here, all of it after a regen
+                clipmap.maxThreads = generationThreads;
+                clipmap.update(settings, cameraPos);
+                clipmapTriangles = clipmap.triangleCount();
+                clipmapSamplesUpdated = clipmap.samplesLastUpdate();
+                if (regenStart >= 0.0) {
+                    lastRegenMs = (glfwGetTime() - regenStart) * 1000.0;
+                    lastRegenSamples = lastRegenStage == RegenStage::Noise ? (double)clipmapSamplesUpdated * (recipe ? recipe->octaves : octaves) : 0.0;
+                    regenStart = -1.0;
+                }
+            }
+            else if (renderer == TerrainRenderer::Tessellated) {
+                // Only the heightmap is generated, the same way as a clipmap level
+                tessellatedTerrain.maxThreads = generationThreads;
+                tessellatedTerrain.update(settings, cameraPos);
+                tessPatches = tessellatedTerrain.patchCount();
+                tessTriangles = tessellatedTerrain.triangleCount();
+                tessSamplesUpdated = tessellatedTerrain.samplesLastUpdate();
+                if (regenStart >= 0.0) {
+                    lastRegenMs = (glfwGetTime() - regenStart) * 1000.0;
+                    lastRegenSamples = lastRegenStage == RegenStage::Noise ? (double)tessSamplesUpdated * (recipe ? recipe->octaves : octaves) : 0.0;
+                    regenStart = -1.0;
                 }
-                terrainNeedsUpdate = false; // Reset update flag
+            }
+            else chunkManager.update(settings, cameraPos, cameraFront);
+            if (renderer == TerrainRenderer::Chunks && regenStart >= 0.0 && chunkManager.upToDate()) {
+                lastRegenMs = (glfwGetTime() - regenStart) * 1000.0;
+                // Only a noise regen evaluates any noise
+                lastRegenSamples = lastRegenStage == RegenStage::Noise ? (double)chunkManager.jobsCompleted() * width * height * (recipe ? recipe->octaves : octaves) : 0.0;
+                regenStart = -1.0;
+            }
+            loadedChunks = chunkManager.chunkCount();
+            chunkFullGridTriangles = 0;
+            chunkManager.forEachVisible([&](const TerrainChunk&) { chunkFullGridTriangles += (size_t)(width - 1) * (height - 1) * 2; });
+            loadedChunkBytes = chunkManager.bytesLoaded();
+            chunkJobsRunning = chunkManager.jobsRunning();
+            chunkJobsCancelled = chunkManager.jobsCancelled();
+            chunkBorderReuse = chunkManager.borderReuseRatio();
+            chunkManager.octaveRange(chunkOctavesFewest, chunkOctavesMost);
+            chunkOctaveEvaluations = chunkManager.octaveEvaluationsPerVertex();
+            if (chunkManager.diskCacheInUse()) {
+                diskCacheHits = chunkManager.diskCacheInUse()->hitCount();
+                diskCacheWrites = chunkManager.diskCacheInUse()->writeCount();
+                diskCacheBytes = (double)chunkManager.diskCacheInUse()->bytes();
             }
 
             // Render terrain chunks
@@ -409,9 +628,64 @@
             glUniformMatrix4fv(glGetUniformLocation(noiseshader.ID, "view"), 1, GL_FALSE, glm::value_ptr(view));
             glUniformMatrix4fv(glGetUniformLocation(noiseshader.ID, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
 
-            for (const TerrainChunk& chunk : chunkList) {
-                glBindVertexArray(chunk.VAO);
-                glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(chunk.terrain.indices.size()), GL_UNSIGNED_INT, 0);
+            // Shared indices for the current grid size, bound to each chunk's VAO as it's drawn
+            IndexLayout layout = useTriangleStrips ? IndexLayout::TriangleStrip : IndexLayout::TriangleList;
+            if (renderer == TerrainRenderer::Lod) {
+                // Every node has the same grid, only its origin and spacing differ
+                const IndexBuffer& nodeIndices = indexCache.get(lodTerrain.quads + 1, lodTerrain.quads + 1, layout);
+                lodTerrain.forEachSelected([&](const LodNode& node) {
+                    glm::vec2 origin = lodTerrain.nodeOrigin(node.key);
+                    setTerrainChunkUniforms(noiseshader, node.terrain, lodTerrain.quads + 1, lodTerrain.quads + 1, origin.x, origin.y, lodVertexSpacing(node.key.level));
+                    setTerrainMorphUniforms(noiseshader, true, cameraPos, lodTerrain.morphStart(node.key.level), lodTerrain.lodRange(node.key.level));
+                    glBindVertexArray(node.VAO);
+                    drawTerrainIndices(nodeIndices);
+                });
+            }
+            else if (renderer == TerrainRenderer::Clipmap) {
+                clipmapShader.use();
+                clipmapShader.setMat4("model", model);
+                clipmapShader.setMat4("view", view);
+                clipmapShader.setMat4("projection", projection);
+                clipmap.draw(clipmapShader);
+            }
+            else if (renderer == TerrainRenderer::Tessellated) {
+                tessellationShader->use();
+                tessellationShader->setMat4("model", model);
+                tessellationShader->setMat4("view", view);
+                tessellationShader->setMat4("projection", projection);
+                GLint viewport[4];
+                glGetIntegerv(GL_VIEWPORT, viewport);
+                tessellatedTerrain.draw(*tessellationShader, cameraPos, (float)viewport[3]);
+            }
+            else {
+                const IndexBuffer& chunkIndices = indexCache.get(width, height, layout);
+                setTerrainMorphUniforms(noiseshader, false);
+                // Chunks further out drop to coarser levels, matched to their neighbours or skirted.
+                // Skirts reach the full height scale down, deeper than any crack can be.
+                bool chunkLod = chunkLodLevels > 1 || chunkSkirts;
+                if (chunkLod) chunkLodIndices.prepare(width, height);
+                int maxChunkLevel = std::min(chunkLodLevels, chunkLodIndices.levels()) - 1;
+                ChunkCoord cameraChunk = chunkCoordAt(settings, cameraPos);
+                setTerrainSkirtUniforms(noiseshader, std::max(1.0f, std::fabs(heightScale)));
+                chunkTriangles = 0;
+                chunkManager.forEachVisible([&](const TerrainChunk& chunk) {
+                    setTerrainChunkUniforms(noiseshader, chunk.terrain, width, height, chunk.xOffset - width / 2.0f, chunk.zOffset - height / 2.0f);
+                    glBindVertexArray(chunk.VAO);
+                    if (chunk.adaptiveMesh.EBO != 0) {
+                        drawTerrainIndices(chunk.adaptiveMesh);
+                        chunkTriangles += chunk.adaptiveMesh.count / 3;
+                    }
+                    else if (chunkLod && maxChunkLevel >= 0) {
+                        int level = chunkLodLevel(chunk.coord, cameraChunk, chunkLodRings, maxChunkLevel);
+                        int coarserEdges = chunkLodCoarserEdges(chunk.coord, cameraChunk, chunkLodRings, maxChunkLevel);
+                        chunkLodIndices.draw(level, coarserEdges, chunkSkirts);
+                        chunkTriangles += chunkLodIndices.triangleCount(level, coarserEdges, chunkSkirts);
+                    }
+                    else {
+                        drawTerrainIndices(chunkIndices);
+                        chunkTriangles += (size_t)(width - 1) * (height - 1) * 2;
+                    }
+                });
             }
 
             // Render ImGui menu
@@ -423,6 +697,12 @@
         }
 
         // Cleanup
+        chunkManager.clear();
+        lodTerrain.clear();
+        clipmap.clear();
+        tessellatedTerrain.clear();
+        indexCache.clear();
+        chunkLodIndices.clear();
         ImGui_ImplOpenGL3_Shutdown();
         ImGui_ImplGlfw_Shutdown();
         ImGui::DestroyContext();
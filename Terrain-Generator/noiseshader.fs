@@ -1,8 +1,21 @@
 #version 330 core
+in vec3 Normal;
 out vec4 FragColor;
 
+// Formats with normals are lit by a fixed sun, the others stay flat
+uniform bool hasNormals;
+
+const vec3 sunDirection = normalize(vec3(0.4, 1.0, 0.3));
+const vec3 terrainColor = vec3(0.0, 1.0, 0.0);
+
 void main()
 {
+    if (hasNormals) {
+        // Lambert plus a little ambient so the slopes facing away don't go black
+        float diffuse = max(dot(normalize(Normal), sunDirection), 0.0);
+        FragColor = vec4(terrainColor * (0.2 + 0.8 * diffuse), 1.0);
+        return;
+    }
     // Set the fragment color to red
     FragColor = vec4(0.0, 1.0, 0.0, 0.7); // RGBA: Red, Green, Blue, Alpha
 }
@@ -1,11 +1,64 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+layout (location = 1) in float aHeight;
+layout (location = 2) in vec3 aNormal;
+layout (location = 3) in float aMorphHeight;
+layout (location = 4) in vec3 aMorphNormal;
+
+out vec3 Normal;
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// Height-only vertex formats: x/z are rebuilt from the vertex index the same way
+// generateTerrain places them, y is decoded as heightDecode.x + aHeight * heightDecode.y
+uniform bool heightOnly;
+uniform int gridWidth;
+uniform int gridHeight;
+uniform vec2 gridOrigin;        // World x/z of vertex (0, 0)
+uniform float vertexSpacing;
+uniform vec2 heightDecode;
+
+// CDLOD geomorphing: between morphRange.x and morphRange.y from the camera a node's vertices
+// slide onto the next coarser level's surface, so there's nothing left to pop when it takes over
+uniform bool lodMorph;
+uniform vec3 cameraPosition;
+uniform vec2 morphRange;
+
+// Skirts: vertices past the grid copy its first row, last row, first column and last column
+// (see terrainSkirtSourceVertex) and hang skirtDepth below them
+uniform float skirtDepth;
+
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    vec3 pos = aPos;
+    int skirt = gl_VertexID - gridWidth * gridHeight;
+    if (heightOnly) {
+        int x = gl_VertexID % gridWidth;
+        int z = gl_VertexID / gridWidth;
+        if (skirt >= 0) {
+            if (skirt < 2 * gridWidth) {
+                x = skirt % gridWidth;
+                z = skirt < gridWidth ? 0 : gridHeight - 1;
+            }
+            else {
+                x = skirt < 2 * gridWidth + gridHeight ? 0 : gridWidth - 1;
+                z = (skirt - 2 * gridWidth) % gridHeight;
+            }
+        }
+        pos.x = gridOrigin.x + float(x) * vertexSpacing;
+        pos.z = gridOrigin.y + float(z) * vertexSpacing;
+        pos.y = heightDecode.x + aHeight * heightDecode.y;
+    }
+    if (skirt >= 0) pos.y -= skirtDepth;
+    vec3 normal = aNormal;
+    if (lodMorph) {
+        float morph = clamp((distance((model * vec4(pos, 1.0)).xyz, cameraPosition) - morphRange.x) / (morphRange.y - morphRange.x), 0.0, 1.0);
+        pos.y = mix(pos.y, aMorphHeight, morph);
+        normal = mix(aNormal, aMorphNormal, morph);
+    }
+    // model is only ever a translation, so it leaves normals alone
+    Normal = mat3(model) * normal;
+    gl_Position = projection * view * model * vec4(pos, 1.0);
 }
\ No newline at end of file
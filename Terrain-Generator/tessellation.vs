@@ -0,0 +1,17 @@
+#version 400 core
+out vec2 latticePoint;
+
+// Patch corners, four vertices per patch in the order (0, 0), (1, 0), (0, 1), (1, 1). Patch i of
+// the grid starts at lattice point firstPatch + (i % patchesPerRow, i / patchesPerRow) * patchQuads,
+// see tessellated_terrain.h
+uniform ivec2 firstPatch;
+uniform int patchesPerRow;
+uniform int patchQuads;
+
+void main()
+{
+    int patchIndex = gl_VertexID / 4;
+    int corner = gl_VertexID % 4;
+    ivec2 point = firstPatch + (ivec2(patchIndex % patchesPerRow, patchIndex / patchesPerRow) + ivec2(corner & 1, corner >> 1)) * patchQuads;
+    latticePoint = vec2(point);
+}
@@ -0,0 +1,416 @@
+#ifndef CHUNK_CACHE_H
+#define CHUNK_CACHE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "noise.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <direct.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Bump whenever a change makes the generator produce different noise for the same settings,
+// so fields cached by older builds stop matching
+const uint32_t TERRAIN_GENERATOR_VERSION = 1;
+
+// 64-bit FNV-1a, continued from hash
+uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+template<class T>
+uint64_t fnv1aValue(const T& value, uint64_t hash) {
+    return fnv1a(&value, sizeof(T), hash);
+}
+
+// Identifies a chunk's normalized noise field: every setting the noise depends on, the chunk's
+// offsets and the generator version. heightScale, falloff and vertex format only reshape the
+// field, so all their combinations share one entry, unless octave culling or coarse octaves
+// make heightScale decide how the field is computed. Formats with normals keep derivative
+// planes in the field and get their own entries. A recipe is keyed by its source text.
+// Fields are hashed one by one so struct padding never gets in.
+uint64_t chunkNoiseKey(const TerrainSettings& settings, float xOffset, float zOffset) {
+    uint64_t hash = fnv1aValue(TERRAIN_GENERATOR_VERSION, 14695981039346656037ull);
+    hash = fnv1aValue(settings.width, hash);
+    hash = fnv1aValue(settings.height, hash);
+    hash = fnv1aValue(settings.scale, hash);
+    hash = fnv1aValue(settings.seed, hash);
+    hash = fnv1aValue(settings.octaves, hash);
+    hash = fnv1aValue(settings.persistence, hash);
+    hash = fnv1aValue(settings.frequency, hash);
+    hash = fnv1aValue(settings.lacunarity, hash);
+    hash = fnv1aValue((int)settings.mode, hash);
+    hash = fnv1aValue((int)settings.fractal, hash);
+    hash = fnv1aValue(noiseFieldPlanes(settings.format), hash);
+    if (settings.recipe) {
+        const std::string& source = settings.recipe->source;
+        hash = fnv1a(source.data(), source.size(), hash);
+    }
+    hash = fnv1aValue(settings.octaveCulling, hash);
+    if (settings.octaveCulling) {
+        hash = fnv1aValue(settings.cullTolerance, hash);
+    }
+    hash = fnv1aValue(settings.coarseOctaves, hash);
+    if (settings.coarseOctaves) hash = fnv1aValue(settings.coarseTolerance, hash);
+    if (settings.octaveCulling || settings.coarseOctaves) hash = fnv1aValue(settings.heightScale, hash);
+    hash = fnv1aValue(xOffset, hash);
+    hash = fnv1aValue(zOffset, hash);
+    return hash;
+}
+
+// Read-only view of a whole file, mapped rather than read
+class MappedFile
+{
+public:
+    MappedFile() {}
+
+    ~MappedFile()
+    {
+        close();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path)
+    {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+            close();
+            return false;
+        }
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!mapping) {
+            close();
+            return false;
+        }
+        bytes = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!bytes) {
+            close();
+            return false;
+        }
+        length = (size_t)fileSize.QuadPart;
+#else
+        descriptor = ::open(path.c_str(), O_RDONLY);
+        if (descriptor < 0) return false;
+        struct stat info;
+        if (fstat(descriptor, &info) != 0 || info.st_size == 0) {
+            close();
+            return false;
+        }
+        void* view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (view == MAP_FAILED) {
+            close();
+            return false;
+        }
+        bytes = view;
+        length = (size_t)info.st_size;
+#endif
+        return true;
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        if (bytes) UnmapViewOfFile(bytes);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (bytes) munmap(const_cast<void*>(bytes), length);
+        if (descriptor >= 0) ::close(descriptor);
+        descriptor = -1;
+#endif
+        bytes = nullptr;
+        length = 0;
+    }
+
+    const void* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#else
+    int descriptor = -1;
+#endif
+    const void* bytes = nullptr;
+    size_t length = 0;
+};
+
+// Layout of a cached field: this header, then planes * width * height floats, plane by plane and
+// row by row, all in the writing machine's byte order
+struct ChunkFileHeader {
+    char magic[4];              // "TGCF"
+    uint32_t formatVersion;
+    uint32_t generatorVersion;
+    uint32_t width, height;
+    uint32_t planes;            // See noiseFieldPlanes
+    uint64_t key;
+};
+
+const uint32_t CHUNK_FILE_FORMAT_VERSION = 2;
+
+// Normalized noise fields on disk, one file per chunkNoiseKey in a directory. Safe to use
+// from several threads at once: files are written under a temporary name and renamed into
+// place, so a reader never sees a partial file. The files are kept under a byte budget; a
+// store that goes over it deletes the oldest files first, by modification time, counting the
+// ones earlier sessions left in the directory.
+class ChunkDiskCache
+{
+public:
+    explicit ChunkDiskCache(const std::string& directory, uint64_t maxBytes = 512ull * 1024 * 1024)
+        : directory(directory), byteBudget(maxBytes)
+    {
+        createDirectory(directory);
+        scanDirectory();
+    }
+
+    const std::string& path() const { return directory; }
+
+    // New budget, files over it are deleted right away
+    void setMaxBytes(uint64_t maxBytes)
+    {
+        std::lock_guard<std::mutex> lock(filesMutex);
+        if (maxBytes == byteBudget) return;
+        byteBudget = maxBytes;
+        trimToBudget();
+    }
+
+    uint64_t maxBytes() const
+    {
+        std::lock_guard<std::mutex> lock(filesMutex);
+        return byteBudget;
+    }
+
+    // Bytes of cached fields in the directory
+    uint64_t bytes() const
+    {
+        std::lock_guard<std::mutex> lock(filesMutex);
+        return totalBytes;
+    }
+
+    // Fills field with the cached noise for key, false if there isn't a matching file
+    bool load(uint64_t key, int width, int height, int planes, std::vector<float>& field)
+    {
+        MappedFile file;
+        size_t count = (size_t)width * height * planes;
+        if (!file.open(fileFor(key)) || file.size() != sizeof(ChunkFileHeader) + count * sizeof(float)) {
+            misses++;
+            return false;
+        }
+
+        ChunkFileHeader header;
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, "TGCF", 4) != 0 || header.formatVersion != CHUNK_FILE_FORMAT_VERSION ||
+            header.generatorVersion != TERRAIN_GENERATOR_VERSION || header.width != (uint32_t)width ||
+            header.height != (uint32_t)height || header.planes != (uint32_t)planes || header.key != key) {
+            misses++;
+            return false;
+        }
+
+        field.resize(count);
+        std::memcpy(field.data(), static_cast<const char*>(file.data()) + sizeof(header), count * sizeof(float));
+        hits++;
+        return true;
+    }
+
+    bool store(uint64_t key, int width, int height, int planes, const std::vector<float>& field)
+    {
+        ChunkFileHeader header;
+        std::memcpy(header.magic, "TGCF", 4);
+        header.formatVersion = CHUNK_FILE_FORMAT_VERSION;
+        header.generatorVersion = TERRAIN_GENERATOR_VERSION;
+        header.width = (uint32_t)width;
+        header.height = (uint32_t)height;
+        header.planes = (uint32_t)planes;
+        header.key = key;
+
+        std::string target = fileFor(key);
+        std::ostringstream temporary;
+        temporary << target << "." << std::this_thread::get_id() << ".tmp";
+        {
+            std::ofstream out(temporary.str().c_str(), std::ios::binary | std::ios::trunc);
+            if (!out) return false;
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(field.data()), field.size() * sizeof(float));
+            if (!out) {
+                out.close();
+                std::remove(temporary.str().c_str());
+                return false;
+            }
+        }
+        // Another thread may have stored the same key first, either copy is the same data
+        if (std::rename(temporary.str().c_str(), target.c_str()) != 0) {
+            std::remove(temporary.str().c_str());
+            return false;
+        }
+        writes++;
+
+        std::lock_guard<std::mutex> lock(filesMutex);
+        addFile(key, sizeof(header) + field.size() * sizeof(float));
+        trimToBudget();
+        return true;
+    }
+
+    int hitCount() const { return hits; }
+    int missCount() const { return misses; }
+    int writeCount() const { return writes; }
+    int evictionCount() const { return evictions; }
+
+private:
+    struct CachedFile {
+        int64_t modified;
+        uint64_t key;
+        uint64_t bytes;
+    };
+
+    // Files from earlier sessions, oldest first ahead of anything this session stores
+    void scanDirectory()
+    {
+        std::vector<CachedFile> found;
+#ifdef _WIN32
+        WIN32_FIND_DATAA data;
+        HANDLE find = FindFirstFileA((directory + "/*.chunk").c_str(), &data);
+        if (find != INVALID_HANDLE_VALUE) {
+            do {
+                CachedFile file;
+                if (!keyFromName(data.cFileName, file.key)) continue;
+                file.bytes = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+                file.modified = (int64_t)(((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime);
+                found.push_back(file);
+            } while (FindNextFileA(find, &data));
+            FindClose(find);
+        }
+#else
+        DIR* dir = opendir(directory.c_str());
+        if (dir) {
+            while (dirent* entry = readdir(dir)) {
+                CachedFile file;
+                struct stat info;
+                if (!keyFromName(entry->d_name, file.key)) continue;
+                if (stat((directory + "/" + entry->d_name).c_str(), &info) != 0) continue;
+                file.bytes = (uint64_t)info.st_size;
+                file.modified = (int64_t)info.st_mtime;
+                found.push_back(file);
+            }
+            closedir(dir);
+        }
+#endif
+        std::sort(found.begin(), found.end(), [](const CachedFile& a, const CachedFile& b) {
+            return a.modified < b.modified;
+        });
+        std::lock_guard<std::mutex> lock(filesMutex);
+        for (const CachedFile& file : found) addFile(file.key, file.bytes);
+        trimToBudget();
+    }
+
+    // Parses the key back out of a name fileFor made
+    static bool keyFromName(const char* name, uint64_t& key)
+    {
+        if (std::strlen(name) != 22 || std::strcmp(name + 16, ".chunk") != 0) return false;
+        for (int i = 0; i < 16; i++) {
+            if (!std::isxdigit((unsigned char)name[i])) return false;
+        }
+        key = std::strtoull(std::string(name, 16).c_str(), nullptr, 16);
+        return true;
+    }
+
+    // Caller holds filesMutex. A key stored again keeps its place in the eviction order.
+    void addFile(uint64_t key, uint64_t bytes)
+    {
+        std::unordered_map<uint64_t, uint64_t>::iterator it = fileBytes.find(key);
+        if (it != fileBytes.end()) {
+            totalBytes -= it->second;
+            it->second = bytes;
+        }
+        else {
+            fileBytes[key] = bytes;
+            evictionOrder.push_back(key);
+        }
+        totalBytes += bytes;
+    }
+
+    // Caller holds filesMutex. A file a reader still has open on Windows can't be deleted; it's
+    // forgotten anyway and counted again by the next session's scan.
+    void trimToBudget()
+    {
+        while (totalBytes > byteBudget && !evictionOrder.empty()) {
+            uint64_t key = evictionOrder.front();
+            evictionOrder.pop_front();
+            std::unordered_map<uint64_t, uint64_t>::iterator it = fileBytes.find(key);
+            totalBytes -= it->second;
+            fileBytes.erase(it);
+            std::remove(fileFor(key).c_str());
+            evictions++;
+        }
+    }
+
+    std::string fileFor(uint64_t key) const
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.chunk", (unsigned long long)key);
+        return directory + "/" + name;
+    }
+
+    // Creates the directory if it's missing, its parent has to exist
+    static void createDirectory(const std::string& path)
+    {
+#ifdef _WIN32
+        _mkdir(path.c_str());
+#else
+        mkdir(path.c_str(), 0755);
+#endif
+    }
+
+    std::string directory;
+    std::atomic<int> hits{ 0 };
+    std::atomic<int> misses{ 0 };
+    std::atomic<int> writes{ 0 };
+    std::atomic<int> evictions{ 0 };
+
+    mutable std::mutex filesMutex;
+    uint64_t byteBudget;
+    uint64_t totalBytes = 0;
+    std::unordered_map<uint64_t, uint64_t> fileBytes;  // Size of each cached file by key
+    std::deque<uint64_t> evictionOrder;                 // Keys, oldest file first
+};
+
+#endif
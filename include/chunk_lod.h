@@ -0,0 +1,271 @@
+#ifndef CHUNK_LOD_H
+#define CHUNK_LOD_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include "chunk_manager.h"
+#include "noise.h"
+#include "terrain_mesh.h"
+
+// Levels of detail for chunks without new vertex data: level l draws every 2^l-th row and
+// column of the chunk's own vertex grid (plus the last one, so sizes that don't divide evenly
+// still reach the far edge). A chunk next to a coarser one would leave T-junctions on their
+// shared edge, so each level has a variant of its indices for every combination of coarser
+// neighbours, whose edge rows only use the vertices the coarser neighbour has. Alternatively
+// the skirted variant hangs a wall of skirt vertices (see terrainSkirtVertexCount) under every
+// edge to hide the cracks instead. All of them are built once per grid size; picking one at
+// draw time costs nothing.
+
+// Chunk edges, bits of the coarser-neighbour mask
+enum ChunkEdge {
+    ChunkEdgeWest = 1,      // x = 0, the chunk at coord.x - 1
+    ChunkEdgeEast = 2,      // x = width - 1
+    ChunkEdgeSouth = 4,     // z = 0, the chunk at coord.z - 1
+    ChunkEdgeNorth = 8,     // z = height - 1
+    ChunkEdgeCombinations = 16
+};
+
+// Coarsest level that still has two cells across the chunk, -1 for grids too small for any
+int chunkLodMaxLevel(int width, int height) {
+    int quads = std::min(width, height) - 1;
+    if (quads < 2) return -1;
+    int level = 0;
+    while ((2 << level) < quads) level++;
+    return level;
+}
+
+// Vertex rows or columns level uses along an edge of quads cells: every step-th one and the last
+void chunkLodLine(int quads, int level, std::vector<int>& line) {
+    line.clear();
+    for (int i = 0; i < quads; i += 1 << level) line.push_back(i);
+    line.push_back(quads);
+}
+
+// Level of the chunk at coord with the camera in chunk center: full detail for the first
+// ringsPerLevel rings of chunks around it, then one level coarser every ringsPerLevel rings.
+// Neighbours are never more than one level apart, so one coarser variant per edge covers it.
+int chunkLodLevel(const ChunkCoord& coord, const ChunkCoord& center, int ringsPerLevel, int maxLevel) {
+    int ring = std::max(std::abs(coord.x - center.x), std::abs(coord.z - center.z));
+    return std::min(ring / std::max(ringsPerLevel, 1), maxLevel);
+}
+
+// Edges of the chunk at coord whose neighbour is at a coarser level than it
+int chunkLodCoarserEdges(const ChunkCoord& coord, const ChunkCoord& center, int ringsPerLevel, int maxLevel) {
+    int level = chunkLodLevel(coord, center, ringsPerLevel, maxLevel);
+    const int neighbours[4][3] = { { -1, 0, ChunkEdgeWest }, { 1, 0, ChunkEdgeEast }, { 0, -1, ChunkEdgeSouth }, { 0, 1, ChunkEdgeNorth } };
+    int edges = 0;
+    for (const int* neighbour : neighbours) {
+        ChunkCoord next = { coord.x + neighbour[0], coord.z + neighbour[1] };
+        if (chunkLodLevel(next, center, ringsPerLevel, maxLevel) > level) edges |= neighbour[2];
+    }
+    return edges;
+}
+
+// Appends triangle (a, b, c) of a width wide grid, turned to the winding of
+// generateTerrainIndexRows whichever way round it was given
+template<class Index>
+void appendChunkLodTriangle(int width, int ax, int az, int bx, int bz, int cx, int cz, std::vector<Index>& indices) {
+    if ((bx - ax) * (cz - az) - (cx - ax) * (bz - az) > 0) {
+        std::swap(bx, cx);
+        std::swap(bz, cz);
+    }
+    indices.push_back((Index)(az * width + ax));
+    indices.push_back((Index)(bz * width + bx));
+    indices.push_back((Index)(cz * width + cx));
+}
+
+// Triangulates the band between an edge of the chunk and the first row of vertices inside it.
+// outer holds the edge's vertices, inner the inner row's, both as positions along the edge;
+// inner runs from the second to the second to last of the chunk's own columns, so the bands of
+// two edges meet on the diagonal of the corner cell. Zips the two rows together left to right.
+template<class Index>
+void appendChunkLodBand(int width, bool alongX, int outerRow, int innerRow, const std::vector<int>& outer, const std::vector<int>& inner, std::vector<Index>& indices) {
+    // Position i along the edge in row r, as grid x, z
+    auto x = [&](int i, int r) { return alongX ? i : r; };
+    auto z = [&](int i, int r) { return alongX ? r : i; };
+    size_t o = 0, n = 0;
+    while (o + 1 < outer.size() || n + 1 < inner.size()) {
+        if (n + 1 == inner.size() || (o + 1 < outer.size() && outer[o + 1] < inner[n + 1])) {
+            appendChunkLodTriangle(width, x(outer[o], outerRow), z(outer[o], outerRow), x(outer[o + 1], outerRow), z(outer[o + 1], outerRow),
+                x(inner[n], innerRow), z(inner[n], innerRow), indices);
+            o++;
+        }
+        else {
+            appendChunkLodTriangle(width, x(outer[o], outerRow), z(outer[o], outerRow), x(inner[n], innerRow), z(inner[n], innerRow),
+                x(inner[n + 1], innerRow), z(inner[n + 1], innerRow), indices);
+            n++;
+        }
+    }
+}
+
+// Triangle list for level of a width x height grid, with the edges in coarserEdges matched to
+// a neighbour one level coarser. level must be at most chunkLodMaxLevel.
+template<class Index>
+void generateChunkLodIndices(int width, int height, int level, int coarserEdges, std::vector<Index>& indices) {
+    std::vector<int> columns, rows, coarseColumns, coarseRows;
+    chunkLodLine(width - 1, level, columns);
+    chunkLodLine(height - 1, level, rows);
+    chunkLodLine(width - 1, level + 1, coarseColumns);
+    chunkLodLine(height - 1, level + 1, coarseRows);
+
+    // Cells clear of the edges, split like generateTerrainIndexRows
+    for (size_t j = 1; j + 2 < rows.size(); j++) {
+        for (size_t i = 1; i + 2 < columns.size(); i++) {
+            appendChunkLodTriangle(width, columns[i], rows[j], columns[i], rows[j + 1], columns[i + 1], rows[j], indices);
+            appendChunkLodTriangle(width, columns[i + 1], rows[j], columns[i], rows[j + 1], columns[i + 1], rows[j + 1], indices);
+        }
+    }
+
+    std::vector<int> innerColumns(columns.begin() + 1, columns.end() - 1);
+    std::vector<int> innerRows(rows.begin() + 1, rows.end() - 1);
+    const int last = (int)columns.size() - 1, top = (int)rows.size() - 1;
+    appendChunkLodBand(width, true, 0, rows[1], coarserEdges & ChunkEdgeSouth ? coarseColumns : columns, innerColumns, indices);
+    appendChunkLodBand(width, true, rows[top], rows[top - 1], coarserEdges & ChunkEdgeNorth ? coarseColumns : columns, innerColumns, indices);
+    appendChunkLodBand(width, false, 0, columns[1], coarserEdges & ChunkEdgeWest ? coarseRows : rows, innerRows, indices);
+    appendChunkLodBand(width, false, columns[last], columns[last - 1], coarserEdges & ChunkEdgeEast ? coarseRows : rows, innerRows, indices);
+}
+
+// Wall under every edge of level's triangles, from the edge down to its skirt vertices
+template<class Index>
+void generateChunkSkirtIndices(int width, int height, int level, std::vector<Index>& indices) {
+    std::vector<int> columns, rows;
+    chunkLodLine(width - 1, level, columns);
+    chunkLodLine(height - 1, level, rows);
+    const int grid = width * height;
+    // Quad from edge vertices a and b down to the skirt vertices under them
+    auto wall = [&](int a, int b, int skirtA, int skirtB) {
+        indices.push_back((Index)a);
+        indices.push_back((Index)skirtA);
+        indices.push_back((Index)b);
+        indices.push_back((Index)b);
+        indices.push_back((Index)skirtA);
+        indices.push_back((Index)skirtB);
+    };
+    for (size_t i = 0; i + 1 < columns.size(); i++) {
+        int a = columns[i], b = columns[i + 1];
+        wall(a, b, grid + a, grid + b);
+        wall((height - 1) * width + a, (height - 1) * width + b, grid + width + a, grid + width + b);
+    }
+    for (size_t j = 0; j + 1 < rows.size(); j++) {
+        int a = rows[j], b = rows[j + 1];
+        wall(a * width, b * width, grid + 2 * width + a, grid + 2 * width + b);
+        wall(a * width + width - 1, b * width + width - 1, grid + 2 * width + height + a, grid + 2 * width + height + b);
+    }
+}
+
+// Every level's index variants for one grid size in a single element buffer: per level, one
+// range for each coarser-edge mask followed by the skirted range. Rebuilt when the grid size
+// changes, which regenerates every chunk anyway.
+class ChunkLodIndices
+{
+public:
+    ChunkLodIndices() {}
+
+    ~ChunkLodIndices()
+    {
+        clear();
+    }
+
+    ChunkLodIndices(const ChunkLodIndices&) = delete;
+    ChunkLodIndices& operator=(const ChunkLodIndices&) = delete;
+
+    // Builds the variants for width x height unless they're already there
+    void prepare(int width, int height)
+    {
+        if (EBO != 0 && width == gridWidth && height == gridHeight) return;
+        clear();
+        gridWidth = width;
+        gridHeight = height;
+        maxLevel = chunkLodMaxLevel(width, height);
+        if (maxLevel < 0) return;
+
+        // Skirt vertices are indexed too
+        if ((size_t)width * height + terrainSkirtVertexCount(width, height) <= 0x10000) upload<uint16_t>(GL_UNSIGNED_SHORT);
+        else upload<uint32_t>(GL_UNSIGNED_INT);
+    }
+
+    int levels() const
+    {
+        return maxLevel + 1;
+    }
+
+    // Triangles the variant draws
+    size_t triangleCount(int level, int coarserEdges, bool skirts) const
+    {
+        return ranges[rangeIndex(level, coarserEdges, skirts)].count / 3;
+    }
+
+    // Draws the bound VAO at level, matched to the coarser neighbours or skirted, attaching the
+    // buffer to the VAO first
+    void draw(int level, int coarserEdges, bool skirts) const
+    {
+        const Range& range = ranges[rangeIndex(level, coarserEdges, skirts)];
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glDrawElements(GL_TRIANGLES, range.count, type, (void*)(range.first * (type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t))));
+    }
+
+    void clear()
+    {
+        if (EBO != 0) glDeleteBuffers(1, &EBO);
+        EBO = 0;
+        ranges.clear();
+        gridWidth = gridHeight = -1;
+        maxLevel = -1;
+    }
+
+private:
+    struct Range {
+        size_t first;
+        GLsizei count;
+    };
+
+    // Skirts use the level's plain edges
+    size_t rangeIndex(int level, int coarserEdges, bool skirts) const
+    {
+        level = std::max(0, std::min(level, maxLevel));
+        return (size_t)level * (ChunkEdgeCombinations + 1) + (skirts ? ChunkEdgeCombinations : coarserEdges & (ChunkEdgeCombinations - 1));
+    }
+
+    template<class Index>
+    void upload(GLenum indexType)
+    {
+        std::vector<Index> indices;
+        for (int level = 0; level <= maxLevel; level++) {
+            for (int edges = 0; edges <= ChunkEdgeCombinations; edges++) {
+                Range range;
+                range.first = indices.size();
+                if (edges < ChunkEdgeCombinations) {
+                    generateChunkLodIndices(gridWidth, gridHeight, level, edges, indices);
+                }
+                else {
+                    generateChunkLodIndices(gridWidth, gridHeight, level, 0, indices);
+                    generateChunkSkirtIndices(gridWidth, gridHeight, level, indices);
+                }
+                range.count = (GLsizei)(indices.size() - range.first);
+                ranges.push_back(range);
+            }
+        }
+        type = indexType;
+
+        // Upload without disturbing whichever VAO is bound
+        GLint boundVAO = 0;
+        glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &boundVAO);
+        glBindVertexArray(0);
+        glGenBuffers(1, &EBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(Index), indices.data(), GL_STATIC_DRAW);
+        glBindVertexArray(boundVAO);
+    }
+
+    unsigned int EBO = 0;
+    GLenum type = GL_UNSIGNED_SHORT;
+    std::vector<Range> ranges;
+    int gridWidth = -1, gridHeight = -1;
+    int maxLevel = -1;
+};
+
+#endif
@@ -0,0 +1,700 @@
+#ifndef CHUNK_MANAGER_H
+#define CHUNK_MANAGER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "chunk_cache.h"
+#include "mpsc_queue.h"
+#include "noise.h"
+#include "rtin_mesh.h"
+#include "terrain_mesh.h"
+
+// What a settings change invalidates, cheapest first. Each stage feeds the next, so a change
+// redoes its own stage and every later one.
+enum class RegenStage {
+    None,
+    Mesh,   // Vertex format: the same heights, stored differently. Switching normals on or off
+            // changes what the noise field holds and is a Noise change.
+    Shape,  // Height scale and edge falloff: one pass over the chunk's cached normalized noise
+    Noise   // Everything else. Normalization by maxValue happens inside the noise kernel, so
+            // persistence and octaves land here too.
+};
+
+const char* regenStageName(RegenStage stage) {
+    switch (stage) {
+    case RegenStage::Mesh: return "mesh";
+    case RegenStage::Shape: return "height";
+    case RegenStage::Noise: return "noise";
+    default: return "none";
+    }
+}
+
+// The earliest stage a change from before to after has to redo. A grid size change also moves
+// every chunk, which ChunkManager::update handles by starting over.
+RegenStage regenStageFor(const TerrainSettings& before, const TerrainSettings& after) {
+    if (before.width != after.width || before.height != after.height || before.scale != after.scale || before.seed != after.seed ||
+        before.octaves != after.octaves || before.persistence != after.persistence || before.frequency != after.frequency ||
+        before.lacunarity != after.lacunarity || before.mode != after.mode || before.fractal != after.fractal || before.recipe != after.recipe ||
+        noiseFieldPlanes(before.format) != noiseFieldPlanes(after.format) ||
+        before.octaveCulling != after.octaveCulling || (after.octaveCulling && before.cullTolerance != after.cullTolerance) ||
+        before.coarseOctaves != after.coarseOctaves || (after.coarseOctaves && before.coarseTolerance != after.coarseTolerance)) {
+        return RegenStage::Noise;
+    }
+    // Octave culling and coarse octaves work to a height tolerance, so with either on the
+    // height scale feeds the noise
+    if ((after.octaveCulling || after.coarseOctaves) && before.heightScale != after.heightScale) return RegenStage::Noise;
+    if (before.heightScale != after.heightScale || before.falloff != after.falloff) return RegenStage::Shape;
+    if (before.format != after.format) return RegenStage::Mesh;
+    return RegenStage::None;
+}
+
+// Integer position of a chunk on the chunk grid
+struct ChunkCoord {
+    int x, z;
+};
+
+struct TerrainChunk {
+    unsigned int VAO = 0, VBO = 0;  // Created on the first upload
+    TerrainData terrain;
+    float xOffset = 0.0f, zOffset = 0.0f;
+    ChunkCoord coord = { 0, 0 };
+    size_t bytes = 0;           // CPU copy, VBO and noise field, counted against the memory budget
+    int version = -1;           // Settings version of the uploaded data, -1 until there is some
+    int requestedVersion = -1;  // Newest settings version a job has been started for
+    std::shared_ptr<std::atomic<bool>> pendingJob;  // Cancel flag of the newest job, while it runs
+    std::shared_ptr<const std::vector<float>> noiseField;  // Normalized fBm behind the uploaded data
+    RegenStage staleStage = RegenStage::None;   // Earliest stage changed since the data was current
+    int octaves = 0;            // Octaves in the noise field, after culling
+    // Adaptive mesh, see rtin_mesh.h. The chunk's own error hierarchy is null for grids that
+    // aren't 2^k + 1 square; the mesh's is raised on the borders to match the neighbours'.
+    std::shared_ptr<const std::vector<float>> rtinErrors;
+    std::vector<float> meshErrors;
+    IndexBuffer adaptiveMesh = IndexBuffer();   // EBO 0 while the chunk draws the full grid
+    float meshTolerance = -1.0f;    // Tolerance adaptiveMesh was built for
+    bool meshErrorsStale = true;    // The chunk or a neighbour changed since meshErrors was made
+};
+
+// Neighbouring chunks' noise fields for the current settings, null where there's none. Chunks
+// overlap by one vertex, so each neighbour already holds one edge of this chunk, in every plane.
+struct ChunkBorders {
+    std::shared_ptr<const std::vector<float>> west, east;   // Chunks at x - 1 and x + 1
+    std::shared_ptr<const std::vector<float>> south, north; // Chunks at z - 1 and z + 1
+};
+
+// Where a chunk's noise samples came from
+struct ChunkJobStats {
+    int samplesEvaluated = 0;   // Run through the fBm kernel
+    int samplesReused = 0;      // Copied from a neighbour's shared edge
+    int octaves = 0;            // Octaves in the chunk's noise, after culling
+    double octaveEvaluations = 0.0; // Single-octave noise evaluations, coarse grids included
+};
+
+// A chunk generated on a worker thread, on its way to the GL thread
+struct ChunkResult {
+    ChunkCoord coord = { 0, 0 };
+    int version = -1;
+    float xOffset = 0.0f, zOffset = 0.0f;
+    bool cancelled = false;     // Gave up part way, terrain is incomplete
+    TerrainData terrain;
+    std::shared_ptr<const std::vector<float>> noiseField;
+    std::shared_ptr<const std::vector<float>> rtinErrors;
+    ChunkJobStats stats;
+};
+
+// Neighbouring chunks share their border row, so chunks are one vertex narrower than the grid
+float chunkSpanX(const TerrainSettings& settings) {
+    return (float)std::max(settings.width - 1, 1);
+}
+
+float chunkSpanZ(const TerrainSettings& settings) {
+    return (float)std::max(settings.height - 1, 1);
+}
+
+// Chunk (cx, cz) covers world x from cx * span - width / 2 to cx * span + width / 2 - 1
+ChunkCoord chunkCoordAt(const TerrainSettings& settings, const glm::vec3& position) {
+    ChunkCoord coord;
+    coord.x = (int)std::floor((position.x + settings.width / 2.0f) / chunkSpanX(settings));
+    coord.z = (int)std::floor((position.z + settings.height / 2.0f) / chunkSpanZ(settings));
+    return coord;
+}
+
+// Normalized noise of a whole chunk into field. Edges a neighbour already has are copied from it
+// rather than evaluated; neighbours evaluate the same world positions, so the copies are the
+// same bits. Returns false if cancelled part way.
+bool generateChunkNoise(const TerrainRowJob& job, const ChunkBorders& borders, const std::atomic<bool>& cancelled, float* field, ChunkJobStats& stats) {
+    const int width = job.width;
+    const int height = job.height;
+    const size_t count = (size_t)width * height;
+    const int planes = noiseFieldPlanes(job.format);
+    if (width < 2 || height < 2) {
+        generateNoiseRows(job, field, 0, height);
+        stats.samplesEvaluated += (int)count;
+        return true;
+    }
+    const size_t fieldSize = count * planes;
+    const float* west = borders.west && borders.west->size() == fieldSize ? borders.west->data() : nullptr;
+    const float* east = borders.east && borders.east->size() == fieldSize ? borders.east->data() : nullptr;
+    const float* south = borders.south && borders.south->size() == fieldSize ? borders.south->data() : nullptr;
+    const float* north = borders.north && borders.north->size() == fieldSize ? borders.north->data() : nullptr;
+
+    int zBegin = 0, zEnd = height;
+    if (south) {
+        for (int p = 0; p < planes; p++) {
+            std::memcpy(field + p * count, south + p * count + (size_t)(height - 1) * width, width * sizeof(float));
+        }
+        zBegin = 1;
+        stats.samplesReused += width;
+    }
+    if (north) {
+        for (int p = 0; p < planes; p++) {
+            std::memcpy(field + p * count + (size_t)(height - 1) * width, north + p * count, width * sizeof(float));
+        }
+        zEnd = height - 1;
+        stats.samplesReused += width;
+    }
+
+    int xBegin = west ? 1 : 0;
+    int xEnd = east ? width - 1 : width;
+    for (int z = zBegin; z < zEnd; z++) {
+        if (cancelled.load(std::memory_order_relaxed)) return false;
+        for (int p = 0; p < planes; p++) {
+            size_t first = p * count + (size_t)z * width;
+            if (west) field[first] = west[first + width - 1];
+            if (east) field[first + width - 1] = east[first];
+        }
+        generateNoiseSpan(job, field, z, xBegin, xEnd);
+    }
+    int rows = zEnd - zBegin;
+    stats.samplesReused += rows * (width - (xEnd - xBegin));
+    stats.samplesEvaluated += rows * (xEnd - xBegin);
+    return true;
+}
+
+// Same output as generateTerrain for the chunk at this offset, generated row by row on the
+// calling thread. A noiseField of the right size is taken as the chunk's normalized noise for
+// these settings and only reshaped; otherwise it's loaded from diskCache, or generated (reusing
+// the neighbours' edges) and stored there. diskCache may be null. Gives up between rows once
+// cancelled is set and returns false, and doesn't store a field finished after that.
+bool generateChunkTerrain(const TerrainSettings& settings, float xOffset, float zOffset, const std::atomic<bool>& cancelled,
+    ChunkDiskCache* diskCache, const ChunkBorders& borders, std::shared_ptr<const std::vector<float>>& noiseField,
+    TerrainData& terrain, ChunkJobStats& stats) {
+    if (cancelled.load(std::memory_order_relaxed)) return false;
+    TerrainRowJob job = makeTerrainRowJob(settings.width, settings.height, settings.scale, settings.seed, settings.octaves,
+        settings.persistence, settings.frequency, settings.lacunarity, settings.heightScale, xOffset, zOffset, settings.mode, settings.format, settings.fractal);
+    job.falloff = settings.falloff;
+    job.graph = settings.recipe.get();
+    if (job.graph) stats.octaves = job.graph->octaves;
+    // Vertices are one world unit apart
+    else stats.octaves = settings.octaveCulling ? cullTerrainOctaves(job, 1.0f, settings.cullTolerance) : job.row.tables.octaves;
+
+    int planes = noiseFieldPlanes(settings.format);
+    size_t fieldSize = (size_t)settings.width * settings.height * planes;
+    if (!noiseField || noiseField->size() != fieldSize) {
+        std::shared_ptr<std::vector<float>> field = std::make_shared<std::vector<float>>();
+        uint64_t key = diskCache ? chunkNoiseKey(settings, xOffset, zOffset) : 0;
+        if (!diskCache || !diskCache->load(key, settings.width, settings.height, planes, *field)) {
+            field->resize(fieldSize);
+            if (settings.coarseOctaves && !job.graph && settings.fractal == FractalType::Fbm) {
+                // Coarse grids are cheap enough that the edges aren't worth copying
+                stats.octaveEvaluations = (double)generateNoiseFieldCoarse(job, settings.coarseTolerance, field->data());
+                stats.samplesEvaluated = settings.width * settings.height;
+            }
+            else {
+                if (!generateChunkNoise(job, borders, cancelled, field->data(), stats)) return false;
+                stats.octaveEvaluations = (double)stats.samplesEvaluated * stats.octaves;
+            }
+            // Cancelled means newer settings or an eviction made this field useless, it would
+            // only take up the cache's budget
+            if (cancelled.load(std::memory_order_relaxed)) return false;
+            if (diskCache) diskCache->store(key, settings.width, settings.height, planes, *field);
+        }
+        noiseField = field;
+    }
+
+    allocateTerrainData(terrain, settings.format, settings.width, settings.height, settings.heightScale);
+    shapeTerrainRows(job, noiseField->data(), terrain, 0, settings.height);
+    return true;
+}
+
+size_t terrainDataBytes(const TerrainData& terrain) {
+    return terrain.vertices.size() * sizeof(float) + terrain.heights.size() * sizeof(float) +
+        terrain.packedHeights.size() * sizeof(uint16_t) + terrain.morphTargets.size() * sizeof(float);
+}
+
+// Keeps the chunks within a radius of the camera loaded. Chunks are generated on the shared
+// thread pool and handed back through a lock-free queue; update() uploads them on the GL
+// thread within a time budget, so a regen never stalls a frame for more than that. Jobs start
+// in order of distance from the camera, favouring what's in front of it, and are cancelled as
+// soon as a settings change or an eviction makes their result useless. Chunks
+// that leave the ring stay cached so turning back is free, until the loaded total goes over
+// the memory budget; then the farthest ones are freed first. Chunks inside the ring are never
+// evicted.
+class ChunkManager
+{
+public:
+    int viewRadius = 2;                         // In chunks, measured from the camera's chunk
+    size_t memoryBudget = 64u * 1024u * 1024u;  // Bytes of CPU and GPU vertex data
+    int maxJobsInFlight = 0;                    // Chunks generating at once, 0 = one per pool thread
+    double uploadBudgetMs = 2.0;                // GL upload time per update, at least one chunk
+    float meshTolerance = 0.0f;                 // Height error adaptive meshes may leave, 0 = full grids
+
+    ChunkManager() : results(std::make_shared<MpscQueue<ChunkResult>>()) {}
+
+    // Jobs still running hold their own reference to the queue and finish into it unread
+    ~ChunkManager()
+    {
+        clear();
+    }
+
+    ChunkManager(const ChunkManager&) = delete;
+    ChunkManager& operator=(const ChunkManager&) = delete;
+
+    // Noise fields are looked up in and saved to cache from now on, null turns that off. Jobs
+    // already running keep the cache they started with.
+    void setDiskCache(std::shared_ptr<ChunkDiskCache> cache)
+    {
+        diskCache = cache;
+    }
+
+    ChunkDiskCache* diskCacheInUse() const { return diskCache.get(); }
+
+    // Once per frame on the GL thread: uploads finished chunks, starts jobs for missing or
+    // outdated chunks around the camera, nearest first, then trims the cache to budget
+    void update(const TerrainSettings& settings, const glm::vec3& cameraPos, const glm::vec3& cameraFront)
+    {
+        if (settings.width != gridWidth || settings.height != gridHeight) {
+            // Chunk coordinates depend on the grid size, nothing loaded or running lines up any more
+            clear();
+            version++;
+            firstUsableVersion = version;
+            gridWidth = settings.width;
+            gridHeight = settings.height;
+        }
+        center = chunkCoordAt(settings, cameraPos);
+        eye = glm::vec2(cameraPos.x, cameraPos.z);
+        glm::vec2 front(cameraFront.x, cameraFront.z);
+        viewDir = glm::length(front) > 1e-4f ? glm::normalize(front) : glm::vec2(0.0f);
+        spanX = chunkSpanX(settings);
+        spanZ = chunkSpanZ(settings);
+
+        uploadResults();
+        updateAdaptiveMeshes();
+        startJobs(settings);
+        evictOverBudget();
+    }
+
+    // New settings: every chunk in the ring redoes the given stage onwards in the background and
+    // keeps its old data on screen until then. Running jobs are for the old settings and are
+    // cancelled. Cached chunks outside the ring would be stale, they're dropped.
+    void regenerate(RegenStage stage)
+    {
+        if (stage == RegenStage::None) return;
+        version++;
+        completedJobs = 0;
+        samplesEvaluated = samplesReused = octaveEvaluations = verticesGenerated = 0.0;
+        for (ChunkMap::iterator it = chunks.begin(); it != chunks.end();) {
+            if (!inRing(it->second.coord)) {
+                release(it->second);
+                it = chunks.erase(it);
+            }
+            else {
+                it->second.staleStage = std::max(it->second.staleStage, stage);
+                cancelJob(it->second);
+                ++it;
+            }
+        }
+    }
+
+    // Calls fn(chunk) for every chunk inside the ring that has data
+    template<class Fn>
+    void forEachVisible(Fn fn) const
+    {
+        for (const ChunkMap::value_type& entry : chunks) {
+            if (entry.second.version >= 0 && inRing(entry.second.coord)) fn(entry.second);
+        }
+    }
+
+    void clear()
+    {
+        for (ChunkMap::value_type& entry : chunks) release(entry.second);
+        chunks.clear();
+        loadedBytes = 0;
+    }
+
+    // True once every chunk in the ring is current and no job is left running
+    bool upToDate() const { return jobsInFlight == 0 && jobsWaiting == 0; }
+
+    size_t chunkCount() const { return chunks.size(); }
+    size_t bytesLoaded() const { return loadedBytes; }
+    int jobsRunning() const { return jobsInFlight; }
+    int jobsCompleted() const { return completedJobs; }  // Since the last regenerate()
+    int jobsCancelled() const { return cancelledJobs; }
+    // Fewest and most octaves among the visible chunks, after culling
+    void octaveRange(int& fewest, int& most) const
+    {
+        fewest = FBM_MAX_OCTAVES;
+        most = 0;
+        forEachVisible([&](const TerrainChunk& chunk) {
+            fewest = std::min(fewest, chunk.octaves);
+            most = std::max(most, chunk.octaves);
+        });
+        if (most < fewest) fewest = most;
+    }
+
+    // Single-octave noise evaluations per vertex of generated noise, all octaves together
+    double octaveEvaluationsPerVertex() const
+    {
+        return verticesGenerated > 0.0 ? octaveEvaluations / verticesGenerated : 0.0;
+    }
+
+    // Share of noise samples copied from a neighbour's edge instead of evaluated
+    double borderReuseRatio() const
+    {
+        double total = samplesEvaluated + samplesReused;
+        return total > 0.0 ? samplesReused / total : 0.0;
+    }
+
+private:
+    typedef std::unordered_map<uint64_t, TerrainChunk> ChunkMap;
+
+    static uint64_t key(const ChunkCoord& coord)
+    {
+        return ((uint64_t)(uint32_t)coord.x << 32) | (uint32_t)coord.z;
+    }
+
+    int distanceSq(const ChunkCoord& coord) const
+    {
+        int dx = coord.x - center.x;
+        int dz = coord.z - center.z;
+        return dx * dx + dz * dz;
+    }
+
+    // Round ring rather than a square, the corners are the farthest from view anyway
+    bool inRing(const ChunkCoord& coord) const
+    {
+        return distanceSq(coord) <= viewRadius * viewRadius + viewRadius;
+    }
+
+    // Lower starts sooner: distance from the camera to the chunk's centre, stretched up to twice
+    // as far for chunks behind the view direction
+    float jobPriority(const ChunkCoord& coord) const
+    {
+        glm::vec2 toChunk(coord.x * spanX - 0.5f - eye.x, coord.z * spanZ - 0.5f - eye.y);
+        float distance = glm::length(toChunk);
+        float facing = distance > 0.0f ? glm::dot(toChunk / distance, viewDir) : 1.0f;
+        return distance * (1.5f - 0.5f * facing);
+    }
+
+    void startJobs(const TerrainSettings& settings)
+    {
+        std::vector<ChunkCoord> wanted;
+        for (int dz = -viewRadius; dz <= viewRadius; dz++) {
+            for (int dx = -viewRadius; dx <= viewRadius; dx++) {
+                ChunkCoord coord = { center.x + dx, center.z + dz };
+                if (!inRing(coord)) continue;
+                ChunkMap::const_iterator it = chunks.find(key(coord));
+                if (it == chunks.end() || it->second.requestedVersion < version) wanted.push_back(coord);
+            }
+        }
+        std::vector<std::pair<float, ChunkCoord>> ordered;
+        ordered.reserve(wanted.size());
+        for (const ChunkCoord& coord : wanted) ordered.push_back(std::make_pair(jobPriority(coord), coord));
+        std::sort(ordered.begin(), ordered.end(), [](const std::pair<float, ChunkCoord>& a, const std::pair<float, ChunkCoord>& b) {
+            return a.first < b.first;
+        });
+
+        // Only a few jobs are queued at a time, so the rest are picked in order of the camera's
+        // position when a worker frees up rather than where it was when they were wanted
+        int limit = maxJobsInFlight > 0 ? maxJobsInFlight : sharedThreadPool().size();
+        size_t started = 0;
+        while (started < ordered.size() && jobsInFlight < limit) {
+            TerrainChunk& chunk = chunks[key(ordered[started].second)];
+            chunk.coord = ordered[started].second;
+            chunk.requestedVersion = version;
+            startJob(settings, chunk);
+            started++;
+        }
+        jobsWaiting = (int)(wanted.size() - started);
+    }
+
+    void startJob(const TerrainSettings& settings, TerrainChunk& chunk)
+    {
+        std::shared_ptr<MpscQueue<ChunkResult>> queue = results;
+        std::shared_ptr<ChunkDiskCache> cache = diskCache;
+        std::shared_ptr<std::atomic<bool>> cancelled = std::make_shared<std::atomic<bool>>(false);
+        ChunkCoord coord = chunk.coord;
+        int jobVersion = version;
+        // Anything short of a noise change reuses the chunk's cached field
+        std::shared_ptr<const std::vector<float>> noiseField;
+        ChunkBorders borders;
+        if (chunk.noiseField && chunk.staleStage < RegenStage::Noise) {
+            noiseField = chunk.noiseField;
+        }
+        else {
+            borders.west = currentNoiseField(coord.x - 1, coord.z);
+            borders.east = currentNoiseField(coord.x + 1, coord.z);
+            borders.south = currentNoiseField(coord.x, coord.z - 1);
+            borders.north = currentNoiseField(coord.x, coord.z + 1);
+        }
+        chunk.pendingJob = cancelled;
+        jobsInFlight++;
+        sharedThreadPool().submit([queue, cache, cancelled, settings, coord, jobVersion, noiseField, borders] {
+            ChunkResult result;
+            result.coord = coord;
+            result.version = jobVersion;
+            result.xOffset = coord.x * chunkSpanX(settings);
+            result.zOffset = coord.z * chunkSpanZ(settings);
+            // One thread per chunk, the chunks themselves are what runs in parallel. Cancelled
+            // jobs still report back so the in-flight count stays right.
+            result.noiseField = noiseField;
+            result.cancelled = !generateChunkTerrain(settings, result.xOffset, result.zOffset, *cancelled, cache.get(), borders,
+                result.noiseField, result.terrain, result.stats);
+            if (result.cancelled) {
+                result.terrain = TerrainData();
+                result.noiseField.reset();
+            }
+            else if (rtinGridFits(settings.width, settings.height)) {
+                std::vector<float> heights;
+                terrainVertexHeights(result.terrain, heights);
+                std::shared_ptr<std::vector<float>> errors = std::make_shared<std::vector<float>>(heights.size());
+                computeRtinErrors(settings.width, heights.data(), nullptr, errors->data());
+                result.rtinErrors = errors;
+            }
+            queue->push(std::move(result));
+        });
+    }
+
+    // The chunk's noise field if it matches the current noise settings
+    std::shared_ptr<const std::vector<float>> currentNoiseField(int x, int z) const
+    {
+        ChunkCoord coord = { x, z };
+        ChunkMap::const_iterator it = chunks.find(key(coord));
+        if (it == chunks.end() || it->second.staleStage >= RegenStage::Noise) return nullptr;
+        return it->second.noiseField;
+    }
+
+    void cancelJob(TerrainChunk& chunk)
+    {
+        if (!chunk.pendingJob) return;
+        chunk.pendingJob->store(true, std::memory_order_relaxed);
+        chunk.pendingJob.reset();
+    }
+
+    void uploadResults()
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        ChunkResult result;
+        while (results->tryPop(result)) {
+            jobsInFlight--;
+            if (result.cancelled) {
+                cancelledJobs++;
+                continue;   // Nothing to upload, doesn't count against the time budget
+            }
+            completedJobs++;
+            samplesEvaluated += result.stats.samplesEvaluated;
+            samplesReused += result.stats.samplesReused;
+            octaveEvaluations += result.stats.octaveEvaluations;
+            verticesGenerated += result.stats.samplesEvaluated + result.stats.samplesReused;
+
+            // Evicted chunks, data older than what's already shown and data for another grid
+            // size are dropped
+            ChunkMap::iterator it = chunks.find(key(result.coord));
+            if (it != chunks.end() && result.version > it->second.version && result.version >= firstUsableVersion) {
+                if (result.version == it->second.requestedVersion) it->second.pendingJob.reset();
+                upload(it->second, result);
+            }
+
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            if (elapsed.count() >= uploadBudgetMs) break;
+        }
+    }
+
+    void upload(TerrainChunk& chunk, ChunkResult& result)
+    {
+        GLenum usage = GL_DYNAMIC_DRAW;
+        if (chunk.VAO == 0) {
+            glGenVertexArrays(1, &chunk.VAO);
+            glGenBuffers(1, &chunk.VBO);
+            usage = GL_STATIC_DRAW;
+        }
+        loadedBytes -= std::min(loadedBytes, chunk.bytes);
+
+        chunk.terrain = std::move(result.terrain);
+        chunk.noiseField = std::move(result.noiseField);
+        chunk.xOffset = result.xOffset;
+        chunk.zOffset = result.zOffset;
+        chunk.version = result.version;
+        chunk.octaves = result.stats.octaves;
+        chunk.rtinErrors = std::move(result.rtinErrors);
+        // The shared borders changed for the neighbours too
+        const int neighbours[5][2] = { { 0, 0 }, { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+        for (const int* offset : neighbours) {
+            ChunkCoord coord = { chunk.coord.x + offset[0], chunk.coord.z + offset[1] };
+            ChunkMap::iterator it = chunks.find(key(coord));
+            if (it != chunks.end()) it->second.meshErrorsStale = true;
+        }
+        // Settings changed since the job started leave the chunk stale from the same stage
+        if (chunk.version == version) chunk.staleStage = RegenStage::None;
+
+        glBindVertexArray(chunk.VAO);
+        // Skirt vertices ride along so the skirted index variants can be picked at draw time
+        uploadTerrainVertices(chunk.terrain, chunk.VBO, usage, gridWidth, gridHeight);
+
+        size_t vertexBytes = terrainDataBytes(chunk.terrain);
+        chunk.bytes = vertexBytes * 2 + vertexBytes / ((size_t)gridWidth * gridHeight) * terrainSkirtVertexCount(gridWidth, gridHeight);
+        if (chunk.noiseField) chunk.bytes += chunk.noiseField->size() * sizeof(float);
+        // Plus the merged copy and the index buffer, roughly
+        if (chunk.rtinErrors) chunk.bytes += chunk.rtinErrors->size() * sizeof(float) * 3;
+        loadedBytes += chunk.bytes;
+    }
+
+    // Rebuilds the adaptive meshes of visible chunks whose tolerance or borders changed. A new
+    // tolerance only walks the error hierarchy down to the triangles it keeps; new borders first
+    // redo the hierarchy, raising every border vertex to the larger of the two chunks' errors
+    // there. Both chunks then split their shared edge at the same vertices, so it can't crack.
+    void updateAdaptiveMeshes()
+    {
+        for (ChunkMap::value_type& entry : chunks) {
+            TerrainChunk& chunk = entry.second;
+            if (chunk.version < 0 || !inRing(chunk.coord)) continue;
+            if (meshTolerance <= 0.0f || !chunk.rtinErrors) {
+                releaseAdaptiveMesh(chunk);
+                continue;
+            }
+            if (chunk.meshErrorsStale) {
+                mergeBorderErrors(chunk);
+                chunk.meshErrorsStale = false;
+                chunk.meshTolerance = -1.0f;
+            }
+            if (chunk.meshTolerance != meshTolerance) {
+                uploadAdaptiveMesh(chunk);
+                chunk.meshTolerance = meshTolerance;
+            }
+        }
+    }
+
+    void mergeBorderErrors(TerrainChunk& chunk)
+    {
+        const int size = gridWidth;
+        const int last = size - 1;
+        std::vector<float> errorFloor(chunk.rtinErrors->size(), 0.0f);
+        // Neighbour offset, then where the shared edge is in this chunk and in the neighbour
+        const int borders[4][4] = { { -1, 0, 0, last }, { 1, 0, last, 0 }, { 0, -1, 0, last }, { 0, 1, last, 0 } };
+        for (const int* border : borders) {
+            ChunkCoord coord = { chunk.coord.x + border[0], chunk.coord.z + border[1] };
+            ChunkMap::const_iterator it = chunks.find(key(coord));
+            // Only a neighbour with the same heights on the edge
+            if (it == chunks.end() || it->second.version != chunk.version || !it->second.rtinErrors) continue;
+            const std::vector<float>& neighbourErrors = *it->second.rtinErrors;
+            for (int i = 0; i < size; i++) {
+                size_t own = border[0] != 0 ? (size_t)i * size + border[2] : (size_t)border[2] * size + i;
+                size_t theirs = border[0] != 0 ? (size_t)i * size + border[3] : (size_t)border[3] * size + i;
+                errorFloor[own] = neighbourErrors[theirs];
+            }
+        }
+        std::vector<float> heights;
+        terrainVertexHeights(chunk.terrain, heights);
+        chunk.meshErrors.resize(errorFloor.size());
+        computeRtinErrors(size, heights.data(), errorFloor.data(), chunk.meshErrors.data());
+    }
+
+    void uploadAdaptiveMesh(TerrainChunk& chunk)
+    {
+        IndexBuffer& mesh = chunk.adaptiveMesh;
+        const void* data;
+        size_t bytes;
+        if (terrainFitsShortIndices(gridWidth, gridHeight, IndexLayout::TriangleList)) {
+            buildRtinIndices(gridWidth, chunk.meshErrors.data(), meshTolerance, mesh.indices16);
+            mesh.type = GL_UNSIGNED_SHORT;
+            mesh.count = static_cast<GLsizei>(mesh.indices16.size());
+            data = mesh.indices16.data();
+            bytes = mesh.indices16.size() * sizeof(uint16_t);
+        }
+        else {
+            buildRtinIndices(gridWidth, chunk.meshErrors.data(), meshTolerance, mesh.indices32);
+            mesh.type = GL_UNSIGNED_INT;
+            mesh.count = static_cast<GLsizei>(mesh.indices32.size());
+            data = mesh.indices32.data();
+            bytes = mesh.indices32.size() * sizeof(uint32_t);
+        }
+        mesh.width = gridWidth;
+        mesh.height = gridHeight;
+        mesh.layout = IndexLayout::TriangleList;
+        mesh.mode = GL_TRIANGLES;
+
+        // Into the chunk's VAO, which is where drawTerrainIndices binds it anyway
+        glBindVertexArray(chunk.VAO);
+        if (mesh.EBO == 0) glGenBuffers(1, &mesh.EBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, bytes, data, GL_DYNAMIC_DRAW);
+        glBindVertexArray(0);
+    }
+
+    void releaseAdaptiveMesh(TerrainChunk& chunk)
+    {
+        if (chunk.adaptiveMesh.EBO == 0) return;
+        glDeleteBuffers(1, &chunk.adaptiveMesh.EBO);
+        chunk.adaptiveMesh = IndexBuffer();
+        chunk.meshTolerance = -1.0f;
+    }
+
+    void release(TerrainChunk& chunk)
+    {
+        cancelJob(chunk);
+        releaseAdaptiveMesh(chunk);
+        if (chunk.VAO == 0) return;
+        glDeleteVertexArrays(1, &chunk.VAO);
+        glDeleteBuffers(1, &chunk.VBO);
+    }
+
+    void evictOverBudget()
+    {
+        if (loadedBytes <= memoryBudget) return;
+
+        std::vector<ChunkMap::iterator> cached;
+        for (ChunkMap::iterator it = chunks.begin(); it != chunks.end(); ++it) {
+            if (!inRing(it->second.coord)) cached.push_back(it);
+        }
+        std::sort(cached.begin(), cached.end(), [this](const ChunkMap::iterator& a, const ChunkMap::iterator& b) {
+            return distanceSq(a->second.coord) > distanceSq(b->second.coord);
+        });
+
+        for (ChunkMap::iterator it : cached) {
+            if (loadedBytes <= memoryBudget) break;
+            loadedBytes -= std::min(loadedBytes, it->second.bytes);
+            release(it->second);
+            chunks.erase(it);
+        }
+    }
+
+    ChunkMap chunks;
+    std::shared_ptr<MpscQueue<ChunkResult>> results;   // Written by pool workers, read in update()
+    std::shared_ptr<ChunkDiskCache> diskCache;
+    ChunkCoord center = { 0, 0 };
+    int gridWidth = -1, gridHeight = -1;
+    int version = 0;            // Bumped whenever the settings change
+    int firstUsableVersion = 0; // Results from before the last grid size change don't fit
+    int jobsInFlight = 0;       // Started and not yet taken off the queue
+    int jobsWaiting = 0;        // Wanted by the last update but over the in-flight limit
+    int completedJobs = 0;
+    int cancelledJobs = 0;
+    double samplesEvaluated = 0.0;
+    double samplesReused = 0.0;
+    double octaveEvaluations = 0.0;
+    double verticesGenerated = 0.0;
+    glm::vec2 eye = glm::vec2(0.0f);        // Camera position and view direction in the xz plane
+    glm::vec2 viewDir = glm::vec2(0.0f);
+    float spanX = 1.0f, spanZ = 1.0f;
+    size_t loadedBytes = 0;
+};
+
+#endif
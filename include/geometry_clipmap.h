@@ -0,0 +1,413 @@
+#ifndef GEOMETRY_CLIPMAP_H
+#define GEOMETRY_CLIPMAP_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include <shader_m.h>
+#include "lod_terrain.h"
+#include "noise.h"
+#include "terrain_mesh.h"
+#include "thread_pool.h"
+
+// Geometry clipmap (Losasso and Hoppe): nested square grids centred on the camera, each with
+// twice the vertex spacing of the one inside it and a hole where that one sits. Every level is
+// the same (quads + 1) x (quads + 1) grid, so the rings are drawn from a handful of shared index
+// buffers and the vertex shader reads positions off gl_VertexID and heights off a texture array,
+// one layer per level. Texel (x & mask, z & mask) of a layer holds lattice point (x, z) of that
+// level, so as the camera moves a level's window slides over the texture and only the L-shaped
+// strip it moves into has to be generated and uploaded. Levels sit on the chunks' vertex lattice
+// like the CDLOD nodes and get the same heights (see generateLatticeHeights).
+
+// Triangle list for a (quads + 1)^2 grid minus the holeSize x holeSize quads from (holeX, holeZ),
+// same triangles per quad as generateTerrainIndexRows. holeSize 0 keeps the whole grid. The outer
+// edge also gets a zero-area triangle per pair of quads: its middle vertex sits on the coarser
+// ring's edge, and the sliver covers the pixels that T-junction would otherwise drop.
+template<class Index>
+std::vector<Index> generateClipmapRingIndices(int quads, int holeX, int holeZ, int holeSize) {
+    const int width = quads + 1;
+    std::vector<Index> indices;
+    indices.reserve(((size_t)quads * quads - (size_t)holeSize * holeSize) * 6 + (size_t)quads * 6);
+    for (int z = 0; z < quads; z++) {
+        for (int x = 0; x < quads; x++) {
+            if (x >= holeX && x < holeX + holeSize && z >= holeZ && z < holeZ + holeSize) continue;
+            int topLeft = z * width + x;
+            int topRight = topLeft + 1;
+            int bottomLeft = (z + 1) * width + x;
+            int bottomRight = bottomLeft + 1;
+
+            indices.push_back((Index)topLeft);
+            indices.push_back((Index)bottomLeft);
+            indices.push_back((Index)topRight);
+
+            indices.push_back((Index)topRight);
+            indices.push_back((Index)bottomLeft);
+            indices.push_back((Index)bottomRight);
+        }
+    }
+
+    for (int i = 0; i + 2 <= quads; i += 2) {
+        const int edges[4][3] = {
+            { i, i + 1, i + 2 },                                                        // Top
+            { quads * width + i, quads * width + i + 1, quads * width + i + 2 },        // Bottom
+            { i * width, (i + 1) * width, (i + 2) * width },                            // Left
+            { i * width + quads, (i + 1) * width + quads, (i + 2) * width + quads }     // Right
+        };
+        for (const int* edge : edges) {
+            for (int k = 0; k < 3; k++) indices.push_back((Index)edge[k]);
+        }
+    }
+    return indices;
+}
+
+// Rounds a / b towards minus infinity, b > 0
+long long floorDivide(long long a, long long b) {
+    long long q = a / b;
+    return (a % b != 0 && a < 0) ? q - 1 : q;
+}
+
+// The clipmap's heights: a texture array with one layer per level, holding the height and
+// normal of lattice point (x, z) of the level at texel (x & mask, z & mask). update() slides
+// every level's window to the camera and only generates the strips it moved into. The
+// tessellated renderer (see tessellated_terrain.h) samples its heights from one too.
+class ClipmapTexture
+{
+public:
+    int maxThreads = 0;         // Threads generating strips, 0 = the whole pool plus the caller
+
+    ClipmapTexture() {}
+
+    ~ClipmapTexture()
+    {
+        clear();
+    }
+
+    ClipmapTexture(const ClipmapTexture&) = delete;
+    ClipmapTexture& operator=(const ClipmapTexture&) = delete;
+
+    // Once per frame on the GL thread: (re)creates the texture for levels layers of 2^sizeLog2
+    // texels, recentres every level's window on the camera and generates what the windows moved
+    // into, or everything after regenerate()
+    void update(const TerrainSettings& settings, const glm::vec3& cameraPos, int levels, int sizeLog2)
+    {
+        if (texture == 0 || builtLevels != levels || builtSizeLog2 != sizeLog2) create(levels, sizeLog2);
+        lit = vertexFormatHasNormals(settings.format);
+        origin = glm::vec2(-settings.width / 2.0f, -settings.height / 2.0f);
+        samplesUpdated = 0;
+
+        // Camera in pairs of level 0 vertices; every level's window starts on an even vertex of
+        // its own lattice, so it's also on the next level's and the levels stay nested
+        long long pairX = (long long)std::floor((cameraPos.x - origin.x) / 2.0f);
+        long long pairZ = (long long)std::floor((cameraPos.z - origin.y) / 2.0f);
+        for (int level = 0; level < levels; level++) {
+            long long originX = 2 * floorDivide(pairX, 1LL << level) - windowQuads() / 2;
+            long long originZ = 2 * floorDivide(pairZ, 1LL << level) - windowQuads() / 2;
+            updateLevel(settings, level, originX, originZ);
+        }
+    }
+
+    // New settings: every level is generated again on the next update()
+    void regenerate()
+    {
+        for (ClipmapLevel& level : state) level.valid = false;
+    }
+
+    // Quads per window side, a multiple of 4 so every window starts on the next level's lattice
+    // and there's room for it to sit half a window inside that one
+    int windowQuads() const
+    {
+        return (1 << builtSizeLog2) - 4;
+    }
+
+    // Lattice index of the level's first window vertex, in the level's spacing
+    long long windowOriginX(int level) const { return state[level].originX; }
+    long long windowOriginZ(int level) const { return state[level].originZ; }
+
+    unsigned int id() const { return texture; }
+    int levels() const { return builtLevels; }
+    int sizeLog2() const { return builtSizeLog2; }
+    glm::vec2 latticeOrigin() const { return origin; }  // World x/z of lattice point (0, 0)
+    bool hasNormals() const { return lit; }
+
+    // Lattice points generated by the last update(), which grows with how far the camera moved
+    size_t samplesLastUpdate() const { return samplesUpdated; }
+    size_t bytes() const { return texture == 0 ? 0 : ((size_t)1 << (2 * builtSizeLog2)) * builtLevels * 4 * sizeof(float); }
+
+    void clear()
+    {
+        if (texture != 0) glDeleteTextures(1, &texture);
+        texture = 0;
+        state.clear();
+        builtLevels = builtSizeLog2 = 0;
+    }
+
+private:
+    struct ClipmapLevel {
+        long long originX = 0, originZ = 0; // Lattice index of the window's first vertex, in the level's spacing
+        bool valid = false;
+    };
+
+    void create(int levels, int sizeLog2)
+    {
+        clear();
+        builtLevels = levels;
+        builtSizeLog2 = sizeLog2;
+        state.assign(levels, ClipmapLevel());
+
+        const int size = 1 << sizeLog2;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        // Height and normal per texel, read with texelFetch by the clipmap and through a
+        // filtering sampler by the tessellated renderer
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA32F, size, size, levels, 0, GL_RGBA, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+    }
+
+    void updateLevel(const TerrainSettings& settings, int level, long long originX, long long originZ)
+    {
+        ClipmapLevel& current = state[level];
+        const int size = windowQuads() + 1;
+        long long dx = originX - current.originX, dz = originZ - current.originZ;
+        if (!current.valid || std::llabs(dx) >= size || std::llabs(dz) >= size) {
+            fillRect(settings, level, originX, originZ, size, size);
+        }
+        else {
+            // The window slid: the columns it moved into, then the rows it moved into over the
+            // columns it kept. They go where the texels it left were.
+            if (dx > 0) fillRect(settings, level, current.originX + size, originZ, (int)dx, size);
+            else if (dx < 0) fillRect(settings, level, originX, originZ, (int)-dx, size);
+            long long keptX = std::max(originX, current.originX);
+            int keptWidth = (int)(std::min(originX, current.originX) + size - keptX);
+            if (dz > 0) fillRect(settings, level, keptX, current.originZ + size, keptWidth, (int)dz);
+            else if (dz < 0) fillRect(settings, level, keptX, originZ, keptWidth, (int)-dz);
+        }
+        current.originX = originX;
+        current.originZ = originZ;
+        current.valid = true;
+    }
+    // Generates lattice points [x, x + width) x [z, z + height) of a level and uploads them
+    void fillRect(const TerrainSettings& settings, int level, long long x, long long z, int width, int height)
+    {
+        if (width <= 0 || height <= 0) return;
+        size_t count = (size_t)width * height;
+        std::vector<float> heights(count);
+        std::vector<glm::vec3> normals(lit ? count : 0);
+        std::atomic<bool> cancelled(false);
+        sharedThreadPool().parallelFor(height, maxThreads, [&](int zBegin, int zEnd) {
+            int octaves;
+            generateLatticeHeights(settings, level, x, z + zBegin, width, zEnd - zBegin, cancelled, heights.data() + (size_t)zBegin * width,
+                lit ? normals.data() + (size_t)zBegin * width : nullptr, octaves);
+        });
+
+        std::vector<float> texels(count * 4);
+        for (size_t i = 0; i < count; i++) {
+            glm::vec3 normal = lit ? normals[i] : glm::vec3(0.0f, 1.0f, 0.0f);
+            texels[i * 4 + 0] = heights[i];
+            texels[i * 4 + 1] = normal.x;
+            texels[i * 4 + 2] = normal.y;
+            texels[i * 4 + 3] = normal.z;
+        }
+        uploadRect(level, x, z, width, height, texels.data());
+        samplesUpdated += count;
+    }
+
+    // Writes a block of lattice points to their toroidal texels, split where it wraps around
+    void uploadRect(int level, long long x, long long z, int width, int height, const float* texels)
+    {
+        const int size = 1 << builtSizeLog2;
+        const long long mask = size - 1;
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+        for (int row = 0; row < height;) {
+            int texelZ = (int)((z + row) & mask);
+            int rows = std::min(height - row, size - texelZ);
+            for (int column = 0; column < width;) {
+                int texelX = (int)((x + column) & mask);
+                int columns = std::min(width - column, size - texelX);
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, texelX, texelZ, level, columns, rows, 1, GL_RGBA, GL_FLOAT,
+                    texels + ((size_t)row * width + column) * 4);
+                column += columns;
+            }
+            row += rows;
+        }
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    }
+
+
+    unsigned int texture = 0;
+    std::vector<ClipmapLevel> state;
+    int builtLevels = 0;
+    int builtSizeLog2 = 0;
+    bool lit = false;
+    glm::vec2 origin = glm::vec2(0.0f);
+    size_t samplesUpdated = 0;
+};
+
+class GeometryClipmap
+{
+public:
+    int levels = 8;             // Rings, the finest one is a full grid
+    int textureSizeLog2 = 8;    // Texels per layer side; the grid is 4 vertices narrower
+    float transitionWidth = 0.0f; // Vertices over which a ring blends into the next, 0 = a tenth of the grid
+    int maxThreads = 0;         // Threads generating strips, 0 = the whole pool plus the caller
+
+    GeometryClipmap() {}
+
+    ~GeometryClipmap()
+    {
+        clear();
+    }
+
+    GeometryClipmap(const GeometryClipmap&) = delete;
+    GeometryClipmap& operator=(const GeometryClipmap&) = delete;
+
+    // Quads per grid side, a multiple of 4 so every window starts on the next level's lattice
+    // and the hole inside it is half the grid
+    int gridQuads() const
+    {
+        return (1 << textureSizeLog2) - 4;
+    }
+
+    // Where the far plane has to be for the outermost ring to show
+    float farDistance(const TerrainSettings& settings) const
+    {
+        return (gridQuads() / 2 + 2) * lodVertexSpacing(levels - 1) * 1.5f + std::fabs(settings.heightScale);
+    }
+
+    // Once per frame on the GL thread: recentres every level on the camera and generates what
+    // the windows moved into, or everything after regenerate()
+    void update(const TerrainSettings& settings, const glm::vec3& cameraPos)
+    {
+        heights.maxThreads = maxThreads;
+        heights.update(settings, cameraPos, levels, textureSizeLog2);
+        if (VAO == 0 || builtSizeLog2 != textureSizeLog2) create();
+    }
+
+    // New settings: every level is generated again on the next update()
+    void regenerate()
+    {
+        heights.regenerate();
+    }
+
+    // Draws every level with clipmap.vs; the caller sets the matrices
+    void draw(const Shader& shader) const
+    {
+        if (heights.id() == 0 || VAO == 0) return;
+        const int quads = gridQuads();
+        shader.setInt("heightmap", 0);
+        shader.setInt("gridSize", quads + 1);
+        shader.setInt("textureMask", (1 << textureSizeLog2) - 1);
+        shader.setVec2("latticeOrigin", heights.latticeOrigin());
+        shader.setFloat("transitionWidth", transitionWidth > 0.0f ? transitionWidth : quads / 10.0f);
+        shader.setBool("hasNormals", heights.hasNormals());
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, heights.id());
+        glBindVertexArray(VAO);
+        for (int level = 0; level < heights.levels(); level++) {
+            shader.setInt("level", level);
+            shader.setFloat("levelSpacing", lodVertexSpacing(level));
+            glUniform2i(glGetUniformLocation(shader.ID, "windowOrigin"), (int)heights.windowOriginX(level), (int)heights.windowOriginZ(level));
+            shader.setBool("blendCoarser", level + 1 < heights.levels());
+            drawTerrainIndices(rings[ringFor(level)]);
+        }
+    }
+
+    void clear()
+    {
+        heights.clear();
+        if (VAO != 0) glDeleteVertexArrays(1, &VAO);
+        for (IndexBuffer& ring : rings) {
+            if (ring.EBO != 0) glDeleteBuffers(1, &ring.EBO);
+            ring.EBO = 0;
+        }
+        VAO = 0;
+        builtSizeLog2 = 0;
+    }
+
+    size_t triangleCount() const
+    {
+        if (heights.id() == 0 || VAO == 0) return 0;
+        size_t triangles = 0;
+        for (int level = 0; level < heights.levels(); level++) triangles += rings[ringFor(level)].count / 3;
+        return triangles;
+    }
+
+    // Lattice points generated by the last update(), which grows with how far the camera moved
+    size_t samplesLastUpdate() const { return heights.samplesLastUpdate(); }
+    size_t textureBytes() const { return heights.bytes(); }
+
+private:
+    void create()
+    {
+        if (VAO != 0) glDeleteVertexArrays(1, &VAO);
+        for (IndexBuffer& ring : rings) {
+            if (ring.EBO != 0) glDeleteBuffers(1, &ring.EBO);
+            ring.EBO = 0;
+        }
+        builtSizeLog2 = textureSizeLog2;
+
+        // Positions come from gl_VertexID, the VAO only carries the ring being drawn
+        glGenVertexArrays(1, &VAO);
+
+        // The full grid for the finest level, and the four places the hole can be in a ring:
+        // a level's window starts n / 4 or n / 4 + 1 vertices into the next one's along each axis
+        const int quads = gridQuads();
+        buildRing(rings[0], 0, 0, 0);
+        for (int z = 0; z < 2; z++) {
+            for (int x = 0; x < 2; x++) buildRing(rings[1 + x + 2 * z], quads / 4 + x, quads / 4 + z, quads / 2);
+        }
+    }
+
+    void buildRing(IndexBuffer& ring, int holeX, int holeZ, int holeSize)
+    {
+        const int size = gridQuads() + 1;
+        ring.width = ring.height = size;
+        ring.layout = IndexLayout::TriangleList;
+        ring.mode = GL_TRIANGLES;
+        const void* data;
+        size_t bytes;
+        if (terrainFitsShortIndices(size, size, IndexLayout::TriangleList)) {
+            ring.indices16 = generateClipmapRingIndices<uint16_t>(gridQuads(), holeX, holeZ, holeSize);
+            ring.type = GL_UNSIGNED_SHORT;
+            ring.count = static_cast<GLsizei>(ring.indices16.size());
+            data = ring.indices16.data();
+            bytes = ring.indices16.size() * sizeof(uint16_t);
+        }
+        else {
+            ring.indices32 = generateClipmapRingIndices<uint32_t>(gridQuads(), holeX, holeZ, holeSize);
+            ring.type = GL_UNSIGNED_INT;
+            ring.count = static_cast<GLsizei>(ring.indices32.size());
+            data = ring.indices32.data();
+            bytes = ring.indices32.size() * sizeof(uint32_t);
+        }
+
+        glBindVertexArray(0);
+        glGenBuffers(1, &ring.EBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ring.EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, bytes, data, GL_STATIC_DRAW);
+    }
+
+    int ringFor(int level) const
+    {
+        if (level == 0) return 0;
+        // Where the finer window starts inside this one, in this level's vertices
+        int holeX = (int)(heights.windowOriginX(level - 1) / 2 - heights.windowOriginX(level)) - gridQuads() / 4;
+        int holeZ = (int)(heights.windowOriginZ(level - 1) / 2 - heights.windowOriginZ(level)) - gridQuads() / 4;
+        return 1 + holeX + 2 * holeZ;
+    }
+
+    ClipmapTexture heights;
+    unsigned int VAO = 0;
+    IndexBuffer rings[5] = {};
+    int builtSizeLog2 = 0;
+};
+
+#endif
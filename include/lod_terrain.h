@@ -0,0 +1,533 @@
+#ifndef LOD_TERRAIN_H
+#define LOD_TERRAIN_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "chunk_manager.h"
+#include "mpsc_queue.h"
+#include "noise.h"
+#include "terrain_mesh.h"
+
+// Continuous distance-dependent LOD (CDLOD): the terrain is a quadtree of square nodes that all
+// have the same (quads + 1) x (quads + 1) vertex grid. Level 0 nodes have a vertex every world
+// unit like chunks do; every level up doubles a node's size and its vertex spacing. Nodes sit on
+// the chunks' vertex lattice, so a coarse vertex is exactly a chunk vertex and gets the same
+// height, and every vertex of level L + 1 is also one of level L.
+
+struct LodNodeKey {
+    int level, x, z;    // Node (x, z) of its level, level 0 node (0, 0) starts at chunk (0, 0)'s first vertex
+};
+
+float lodVertexSpacing(int level) {
+    return (float)(1 << level);
+}
+
+// Chunk-local position of a vertex on the chunks' lattice, for the per-chunk edge falloff
+int lodChunkLocalIndex(long long latticeIndex, int chunkSpan) {
+    long long local = latticeIndex % chunkSpan;
+    return (int)(local < 0 ? local + chunkSpan : local);
+}
+
+// Heights of a width x height block of lattice points spaced 2^level apart, the first at
+// level-scaled lattice index (firstX, firstZ): world x = firstX * 2^level - width / 2 for the
+// chunk width in the settings, like the chunks. Each point gets the chunk vertex's exact height,
+// edge falloff included. Also fills normals when given. Gives up between rows once cancelled is
+// set and returns false. Returns the octaves the noise kept in octaves.
+bool generateLatticeHeights(const TerrainSettings& settings, int level, long long firstX, long long firstZ, int width, int height,
+    const std::atomic<bool>& cancelled, float* heights, glm::vec3* normals, int& octaves) {
+    const int step = 1 << level;
+    const float spacing = lodVertexSpacing(level);
+    const size_t count = (size_t)width * height;
+
+    // In units of the lattice spacing, world positions are the chunks' divided by a power of
+    // two, which is exact: the noise sees the same inputs as the chunk vertex at the same spot
+    TerrainRowJob job = makeTerrainRowJob(width, height, settings.scale / spacing, settings.seed, settings.octaves, settings.persistence,
+        settings.frequency, settings.lacunarity, settings.heightScale, (float)firstX, (float)firstZ, settings.mode,
+        settings.format, settings.fractal);
+    job.row.halfWidth = settings.width / 2.0f / spacing;
+    job.graph = settings.recipe.get();
+    if (job.graph) octaves = job.graph->octaves;
+    // One lattice spacing apart, in the job's units
+    else octaves = settings.octaveCulling ? cullTerrainOctaves(job, 1.0f, settings.cullTolerance) : job.row.tables.octaves;
+
+    std::vector<float> noise(count), noiseDx(normals ? count : 0), noiseDz(normals ? count : 0);
+    FbmRowParams row = job.row;
+    for (int z = 0; z < height; z++) {
+        if (cancelled.load(std::memory_order_relaxed)) return false;
+        row.worldZ = ((float)z + job.zOffset) - settings.height / 2.0f / spacing;
+        size_t first = (size_t)z * width;
+        float* dx = normals ? noiseDx.data() + first : nullptr;
+        float* dz = normals ? noiseDz.data() + first : nullptr;
+        if (job.graph) evaluateNoiseGraphRow(*job.graph, row, noise.data() + first, dx, dz, spacing);
+        else if (normals) job.fbmRowGrad(row, noise.data() + first, dx, dz);
+        else job.fbmRow(row, noise.data() + first);
+    }
+
+    // Heights and normals as shapeTerrainRow makes them, with the falloff of the chunk each
+    // point falls in. The derivatives above are per lattice spacing.
+    const int chunkSpanX = std::max(settings.width - 1, 1);
+    const int chunkSpanZ = std::max(settings.height - 1, 1);
+    for (int z = 0; z < height; z++) {
+        int localZ = lodChunkLocalIndex((firstZ + z) * step, chunkSpanZ);
+        for (int x = 0; x < width; x++) {
+            size_t i = (size_t)z * width + x;
+            int localX = lodChunkLocalIndex((firstX + x) * step, chunkSpanX);
+            float falloffFactor = settings.falloff ? calculateFalloffFactor(localX, localZ, settings.width, settings.height) : 1.0f;
+            heights[i] = noise[i] * settings.heightScale * falloffFactor;
+            if (normals) {
+                float dFalloffDx = 0.0f, dFalloffDz = 0.0f;
+                if (settings.falloff) calculateFalloffGradient(localX, localZ, settings.width, settings.height, dFalloffDx, dFalloffDz);
+                float slopeX = settings.heightScale * (noiseDx[i] / spacing * falloffFactor + noise[i] * dFalloffDx);
+                float slopeZ = settings.heightScale * (noiseDz[i] / spacing * falloffFactor + noise[i] * dFalloffDz);
+                normals[i] = glm::normalize(glm::vec3(-slopeX, 1.0f, -slopeZ));
+            }
+        }
+    }
+    return true;
+}
+
+// Generates a node's vertices in the settings' format, plus its morph targets: the height and
+// normal the next level's mesh has at each vertex. Even vertices are shared with that level;
+// odd ones lie on one of its edges, or on the diagonal of one of its quads (the one
+// generateTerrainIndexRows cuts them along), and get the average of the two ends. Fills octaves
+// with the octaves the noise kept. Gives up between rows once cancelled is set and returns false.
+bool generateLodNodeTerrain(const TerrainSettings& settings, int quads, const LodNodeKey& node, const std::atomic<bool>& cancelled,
+    TerrainData& terrain, int& octaves) {
+    const int size = quads + 1;
+    const size_t count = (size_t)size * size;
+    const int step = 1 << node.level;
+    const float halfWidth = settings.width / 2.0f;
+    const float halfHeight = settings.height / 2.0f;
+    const long long firstX = (long long)node.x * quads * step;
+    const long long firstZ = (long long)node.z * quads * step;
+
+    bool normals = vertexFormatHasNormals(settings.format);
+    std::vector<float> heights(count);
+    std::vector<glm::vec3> vertexNormals(normals ? count : 0);
+    if (!generateLatticeHeights(settings, node.level, (long long)node.x * quads, (long long)node.z * quads, size, size, cancelled,
+        heights.data(), normals ? vertexNormals.data() : nullptr, octaves)) return false;
+
+    allocateTerrainData(terrain, settings.format, size, size, settings.heightScale);
+    switch (settings.format) {
+    case VertexFormat::Position3f:
+    case VertexFormat::PositionNormal3f: {
+        int stride = normals ? 6 : 3;
+        for (int z = 0; z < size; z++) {
+            float worldZ = (float)(firstZ + (long long)z * step) - halfHeight;
+            for (int x = 0; x < size; x++) {
+                size_t i = (size_t)z * size + x;
+                float* out = terrain.vertices.data() + i * stride;
+                out[0] = (float)(firstX + (long long)x * step) - halfWidth;
+                out[1] = heights[i];
+                out[2] = worldZ;
+                if (normals) {
+                    out[3] = vertexNormals[i].x;
+                    out[4] = vertexNormals[i].y;
+                    out[5] = vertexNormals[i].z;
+                }
+            }
+        }
+        break;
+    }
+    case VertexFormat::HeightFloat:
+        terrain.heights = heights;
+        break;
+    case VertexFormat::HeightUnorm16: {
+        float toUnit = terrain.heightRange > 0.0f ? 1.0f / terrain.heightRange : 0.0f;
+        for (size_t i = 0; i < count; i++) {
+            float unit = std::min(std::max((heights[i] - terrain.heightBias) * toUnit, 0.0f), 1.0f);
+            terrain.packedHeights[i] = (uint16_t)(unit * 65535.0f + 0.5f);
+            // Morph targets have to meet the heights the shader decodes
+            heights[i] = terrain.heightBias + terrain.packedHeights[i] / 65535.0f * terrain.heightRange;
+        }
+        break;
+    }
+    }
+
+    const int targetStride = normals ? 4 : 1;
+    terrain.morphTargets.resize(count * targetStride);
+    for (int z = 0; z < size; z++) {
+        for (int x = 0; x < size; x++) {
+            // The two vertices of the coarser level this one lies between
+            size_t a = (size_t)z * size + x, b = a;
+            if ((x & 1) && (z & 1)) {
+                a = (size_t)(z - 1) * size + (x + 1);
+                b = (size_t)(z + 1) * size + (x - 1);
+            }
+            else if (x & 1) {
+                a = (size_t)z * size + (x - 1);
+                b = a + 2;
+            }
+            else if (z & 1) {
+                a = (size_t)(z - 1) * size + x;
+                b = a + 2 * size;
+            }
+            float* out = terrain.morphTargets.data() + ((size_t)z * size + x) * targetStride;
+            out[0] = (heights[a] + heights[b]) * 0.5f;
+            if (normals) {
+                glm::vec3 normal = glm::normalize(vertexNormals[a] + vertexNormals[b]);
+                out[1] = normal.x;
+                out[2] = normal.y;
+                out[3] = normal.z;
+            }
+        }
+    }
+    return true;
+}
+
+struct LodNode {
+    unsigned int VAO = 0, VBO = 0;  // Created on the first upload
+    TerrainData terrain;
+    LodNodeKey key = { 0, 0, 0 };
+    size_t bytes = 0;
+    int version = -1;           // Settings version of the uploaded data, -1 until there is some
+    int requestedVersion = -1;  // Newest settings version a job has been started for
+    int wantedFrame = -1;       // Last update() that visited the node
+    int octaves = 0;
+    std::shared_ptr<std::atomic<bool>> pendingJob;
+};
+
+// A node generated on a worker thread, on its way to the GL thread
+struct LodNodeResult {
+    LodNodeKey key = { 0, 0, 0 };
+    int version = -1;
+    bool cancelled = false;
+    TerrainData terrain;
+    int octaves = 0;
+};
+
+// The CDLOD quadtree around the camera. Each frame, nodes within lodRange(level - 1) of the
+// camera are split into their four children and the rest are drawn, so every level covers a
+// ring about twice as wide as the one inside it and the triangle count grows with the log of
+// the view distance rather than its square. A node's vertices morph into the next level's
+// surface over the last quarter of its range, which is where a coarser neighbour can start.
+// Nodes are generated on the shared thread pool, coarsest first; until all four children of a
+// node are ready the node itself is drawn. Like ChunkManager, nodes the camera has left stay
+// cached until the loaded total goes over the memory budget.
+class LodTerrain
+{
+public:
+    int quads = 32;                 // Per node side, even
+    float rangeFactor = 6.0f;       // Level 0 range in node sizes, has to leave room for the morph band
+    float viewDistance = 2000.0f;   // World units, sets the number of levels
+    size_t memoryBudget = 128u * 1024u * 1024u;
+    int maxJobsInFlight = 0;        // 0 = one per pool thread
+    double uploadBudgetMs = 2.0;
+
+    static const int MAX_LEVEL = 16;
+
+    LodTerrain() : results(std::make_shared<MpscQueue<LodNodeResult>>()) {}
+
+    ~LodTerrain()
+    {
+        clear();
+    }
+
+    LodTerrain(const LodTerrain&) = delete;
+    LodTerrain& operator=(const LodTerrain&) = delete;
+
+    // Nodes of level L are split within lodRange(L - 1) of the camera and fully morphed at lodRange(L)
+    float lodRange(int level) const
+    {
+        return rangeFactor * quads * lodVertexSpacing(level);
+    }
+
+    float morphStart(int level) const
+    {
+        return lodRange(level) * 0.75f;
+    }
+
+    // Coarsest level, the first whose range reaches the view distance; its nodes are the roots
+    int topLevel() const
+    {
+        int level = 0;
+        while (level < MAX_LEVEL && lodRange(level) < viewDistance) level++;
+        return level;
+    }
+
+    // Where the far plane has to be for every selected node to show
+    float farDistance(const TerrainSettings& settings) const
+    {
+        return viewDistance + nodeSize(topLevel()) * 1.5f + std::fabs(settings.heightScale);
+    }
+
+    // Once per frame on the GL thread: selects the nodes to draw around the camera, uploads
+    // finished ones and starts jobs for what's missing or outdated
+    void update(const TerrainSettings& settings, const glm::vec3& cameraPos)
+    {
+        if (quads != selectedQuads) {
+            // Node keys mean different areas now
+            clear();
+            version++;
+            firstUsableVersion = version;
+            selectedQuads = quads;
+        }
+        frame++;
+        eye = cameraPos;
+        heightBound = std::fabs(settings.heightScale);
+        halfWidth = settings.width / 2.0f;
+        halfHeight = settings.height / 2.0f;
+
+        uploadResults();
+
+        selected.clear();
+        wanted.clear();
+        int level = topLevel();
+        float size = nodeSize(level);
+        float reach = viewDistance;
+        int x0 = (int)std::floor((eye.x + halfWidth - reach) / size), x1 = (int)std::floor((eye.x + halfWidth + reach) / size);
+        int z0 = (int)std::floor((eye.z + halfHeight - reach) / size), z1 = (int)std::floor((eye.z + halfHeight + reach) / size);
+        for (int z = z0; z <= z1; z++) {
+            for (int x = x0; x <= x1; x++) {
+                LodNodeKey root = { level, x, z };
+                if (boxDistance(root) <= reach) selectNode(root);
+            }
+        }
+
+        startJobs(settings);
+        evictOverBudget();
+    }
+
+    // New settings: every node is regenerated in the background and keeps its old data on
+    // screen until then
+    void regenerate()
+    {
+        version++;
+        for (NodeMap::value_type& entry : nodes) cancelJob(entry.second);
+    }
+
+    // Calls fn(node) for every node selected by the last update(), all of them have data
+    template<class Fn>
+    void forEachSelected(Fn fn) const
+    {
+        for (const LodNode* node : selected) fn(*node);
+    }
+
+    // World x/z of a node's vertex (0, 0)
+    glm::vec2 nodeOrigin(const LodNodeKey& key) const
+    {
+        return glm::vec2(key.x * nodeSize(key.level) - halfWidth, key.z * nodeSize(key.level) - halfHeight);
+    }
+
+    float nodeSize(int level) const
+    {
+        return quads * lodVertexSpacing(level);
+    }
+
+    void clear()
+    {
+        for (NodeMap::value_type& entry : nodes) release(entry.second);
+        nodes.clear();
+        selected.clear();
+        loadedBytes = 0;
+    }
+
+    bool upToDate() const { return jobsInFlight == 0 && jobsWaiting == 0; }
+
+    size_t nodeCount() const { return nodes.size(); }
+    size_t nodesSelected() const { return selected.size(); }
+    size_t trianglesSelected() const { return selected.size() * (size_t)quads * quads * 2; }
+    size_t bytesLoaded() const { return loadedBytes; }
+    int jobsRunning() const { return jobsInFlight; }
+
+private:
+    typedef std::unordered_map<uint64_t, LodNode> NodeMap;
+
+    static uint64_t key(const LodNodeKey& node)
+    {
+        // 24 bits per coordinate covers a million nodes either way even at level 0
+        return ((uint64_t)node.level << 48) | ((uint64_t)((uint32_t)node.x & 0xFFFFFF) << 24) | ((uint32_t)node.z & 0xFFFFFF);
+    }
+
+    // Distance from the camera to the node's bounds, heights taken as the whole possible range
+    float boxDistance(const LodNodeKey& node) const
+    {
+        glm::vec2 origin = nodeOrigin(node);
+        float size = nodeSize(node.level);
+        float dx = std::max(std::max(origin.x - eye.x, eye.x - (origin.x + size)), 0.0f);
+        float dz = std::max(std::max(origin.y - eye.z, eye.z - (origin.y + size)), 0.0f);
+        float dy = std::max(std::fabs(eye.y) - heightBound, 0.0f);
+        return std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+
+    bool hasData(const LodNodeKey& node) const
+    {
+        NodeMap::const_iterator it = nodes.find(key(node));
+        return it != nodes.end() && it->second.version >= 0;
+    }
+
+    void want(const LodNodeKey& node)
+    {
+        LodNode& entry = nodes[key(node)];
+        entry.key = node;
+        entry.wantedFrame = frame;
+        wanted.push_back(node);
+    }
+
+    void selectNode(const LodNodeKey& node)
+    {
+        want(node);
+        if (node.level > 0 && boxDistance(node) < lodRange(node.level - 1)) {
+            LodNodeKey children[4] = {
+                { node.level - 1, node.x * 2, node.z * 2 }, { node.level - 1, node.x * 2 + 1, node.z * 2 },
+                { node.level - 1, node.x * 2, node.z * 2 + 1 }, { node.level - 1, node.x * 2 + 1, node.z * 2 + 1 }
+            };
+            bool ready = true;
+            for (const LodNodeKey& child : children) ready = ready && hasData(child);
+            if (ready) {
+                for (const LodNodeKey& child : children) selectNode(child);
+                return;
+            }
+            // Children are wanted so they get generated, this node stands in for them meanwhile
+            for (const LodNodeKey& child : children) want(child);
+        }
+        LodNode& entry = nodes[key(node)];
+        if (entry.version >= 0) selected.push_back(&entry);
+    }
+
+    void startJobs(const TerrainSettings& settings)
+    {
+        std::vector<LodNodeKey> missing;
+        for (const LodNodeKey& node : wanted) {
+            const LodNode& entry = nodes[key(node)];
+            if (entry.requestedVersion < version) missing.push_back(node);
+        }
+        // Coarse levels first, they cover the most ground; nearest first within a level
+        std::sort(missing.begin(), missing.end(), [this](const LodNodeKey& a, const LodNodeKey& b) {
+            if (a.level != b.level) return a.level > b.level;
+            return boxDistance(a) < boxDistance(b);
+        });
+
+        int limit = maxJobsInFlight > 0 ? maxJobsInFlight : sharedThreadPool().size();
+        size_t started = 0;
+        while (started < missing.size() && jobsInFlight < limit) {
+            LodNode& entry = nodes[key(missing[started])];
+            entry.requestedVersion = version;
+            startJob(settings, entry);
+            started++;
+        }
+        jobsWaiting = (int)(missing.size() - started);
+    }
+
+    void startJob(const TerrainSettings& settings, LodNode& node)
+    {
+        std::shared_ptr<MpscQueue<LodNodeResult>> queue = results;
+        std::shared_ptr<std::atomic<bool>> cancelled = std::make_shared<std::atomic<bool>>(false);
+        LodNodeKey nodeKey = node.key;
+        int jobVersion = version;
+        int nodeQuads = quads;
+        cancelJob(node);
+        node.pendingJob = cancelled;
+        jobsInFlight++;
+        sharedThreadPool().submit([queue, cancelled, settings, nodeKey, jobVersion, nodeQuads] {
+            LodNodeResult result;
+            result.key = nodeKey;
+            result.version = jobVersion;
+            result.cancelled = !generateLodNodeTerrain(settings, nodeQuads, nodeKey, *cancelled, result.terrain, result.octaves);
+            if (result.cancelled) result.terrain = TerrainData();
+            queue->push(std::move(result));
+        });
+    }
+
+    void cancelJob(LodNode& node)
+    {
+        if (!node.pendingJob) return;
+        node.pendingJob->store(true, std::memory_order_relaxed);
+        node.pendingJob.reset();
+    }
+
+    void uploadResults()
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        LodNodeResult result;
+        while (results->tryPop(result)) {
+            jobsInFlight--;
+            if (result.cancelled) continue;
+
+            NodeMap::iterator it = nodes.find(key(result.key));
+            if (it != nodes.end() && result.version > it->second.version && result.version >= firstUsableVersion) {
+                if (result.version == it->second.requestedVersion) it->second.pendingJob.reset();
+                upload(it->second, result);
+            }
+
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            if (elapsed.count() >= uploadBudgetMs) break;
+        }
+    }
+
+    void upload(LodNode& node, LodNodeResult& result)
+    {
+        GLenum usage = GL_DYNAMIC_DRAW;
+        if (node.VAO == 0) {
+            glGenVertexArrays(1, &node.VAO);
+            glGenBuffers(1, &node.VBO);
+            usage = GL_STATIC_DRAW;
+        }
+        loadedBytes -= std::min(loadedBytes, node.bytes);
+
+        node.terrain = std::move(result.terrain);
+        node.version = result.version;
+        node.octaves = result.octaves;
+
+        glBindVertexArray(node.VAO);
+        uploadTerrainVertices(node.terrain, node.VBO, usage);
+
+        node.bytes = terrainDataBytes(node.terrain) * 2;
+        loadedBytes += node.bytes;
+    }
+
+    void release(LodNode& node)
+    {
+        cancelJob(node);
+        if (node.VAO == 0) return;
+        glDeleteVertexArrays(1, &node.VAO);
+        glDeleteBuffers(1, &node.VBO);
+    }
+
+    // Nodes not visited this frame go, least recently wanted first
+    void evictOverBudget()
+    {
+        if (loadedBytes <= memoryBudget) return;
+
+        std::vector<NodeMap::iterator> cached;
+        for (NodeMap::iterator it = nodes.begin(); it != nodes.end(); ++it) {
+            if (it->second.wantedFrame != frame) cached.push_back(it);
+        }
+        std::sort(cached.begin(), cached.end(), [](const NodeMap::iterator& a, const NodeMap::iterator& b) {
+            return a->second.wantedFrame < b->second.wantedFrame;
+        });
+
+        for (NodeMap::iterator it : cached) {
+            if (loadedBytes <= memoryBudget) break;
+            loadedBytes -= std::min(loadedBytes, it->second.bytes);
+            release(it->second);
+            nodes.erase(it);
+        }
+    }
+
+    NodeMap nodes;
+    std::vector<const LodNode*> selected;   // Drawn this frame; unordered_map keeps them in place
+    std::vector<LodNodeKey> wanted;         // Visited this frame, selected or not
+    std::shared_ptr<MpscQueue<LodNodeResult>> results;
+    glm::vec3 eye = glm::vec3(0.0f);
+    float heightBound = 0.0f;
+    float halfWidth = 0.0f, halfHeight = 0.0f;
+    int selectedQuads = -1;
+    int frame = 0;
+    int version = 0;
+    int firstUsableVersion = 0;
+    int jobsInFlight = 0;
+    int jobsWaiting = 0;
+    size_t loadedBytes = 0;
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <atomic>
+#include <utility>
+
+// Unbounded lock-free queue for many producer threads and a single consumer thread (Vyukov's
+// node-based MPSC queue). push() is one atomic exchange and never waits on other producers or
+// on the consumer. tryPop() must only be called from one thread at a time.
+template<class T>
+class MpscQueue
+{
+public:
+    MpscQueue() : tail(new Node())
+    {
+        // Starts with an empty stub node so push and pop never touch the same pointer
+        head.store(tail, std::memory_order_relaxed);
+    }
+
+    ~MpscQueue()
+    {
+        while (tail) {
+            Node* next = tail->next.load(std::memory_order_relaxed);
+            delete tail;
+            tail = next;
+        }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    void push(T value)
+    {
+        Node* node = new Node();
+        node->value = std::move(value);
+        Node* prev = head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    // Moves the oldest item into out. Returns false when the queue is empty, or when a
+    // producer is between its exchange and its link; the item shows up on a later call.
+    bool tryPop(T& out)
+    {
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (!next) return false;
+        // next becomes the new stub, its value is moved out and no longer needed
+        out = std::move(next->value);
+        next->value = T();
+        delete tail;
+        tail = next;
+        return true;
+    }
+
+private:
+    struct Node {
+        std::atomic<Node*> next{ nullptr };
+        T value;
+    };
+
+    std::atomic<Node*> head;    // Last pushed node, shared by producers
+    Node* tail;                 // Consumer side, its successor holds the oldest item
+};
+
+#endif
@@ -5,12 +5,78 @@
 #include <glm/gtc/noise.hpp>
 #include <vector>
 #include <cmath>
+#include <cstdint>
+#include <memory>
+#include "noise_graph.h"
+#include "noise_simd.h"
+#include "thread_pool.h"
 
+// How a chunk's vertices are stored and uploaded. The height-only formats leave x/z out, the
+// vertex shader rebuilds them from gl_VertexID and the chunk offset.
+enum class VertexFormat {
+    Position3f,     // x,y,z floats, 12 bytes per vertex
+    HeightFloat,    // height as a float, 4 bytes per vertex
+    HeightUnorm16,  // height as a normalized uint16 over [-heightScale, heightScale], 2 bytes per vertex
+    PositionNormal3f // x,y,z then the unit surface normal, 24 bytes per vertex
+};
+
+// Indices are not part of a chunk's data: they only depend on width/height, see
+// generateTerrainIndices and IndexBufferCache in terrain_mesh.h
 struct TerrainData {
-    std::vector<float> vertices;  // [x,y,z,  x,y,z,  x,y,z, ...]
-    std::vector<unsigned int> indices;
+    VertexFormat format = VertexFormat::Position3f;
+    std::vector<float> vertices;        // Position3f: [x,y,z,  x,y,z, ...], PositionNormal3f: [x,y,z,nx,ny,nz, ...]
+    std::vector<float> heights;         // HeightFloat: one height per vertex, row by row
+    std::vector<uint16_t> packedHeights; // HeightUnorm16: one quantized height per vertex
+    // Height-only formats decode as heightBias + stored * heightRange
+    float heightBias = 0.0f;
+    float heightRange = 1.0f;
+    // LOD nodes only (see lod_terrain.h): per vertex the height of the next coarser level's surface
+    // there, followed by its normal for formats with normals. Empty for chunks.
+    std::vector<float> morphTargets;
 };
 
+const char* vertexFormatName(VertexFormat format) {
+    switch (format) {
+    case VertexFormat::HeightFloat: return "Height only (float)";
+    case VertexFormat::HeightUnorm16: return "Height only (unorm16)";
+    case VertexFormat::PositionNormal3f: return "Position + normal (lit)";
+    default: return "Position (xyz float)";
+    }
+}
+
+bool vertexFormatHasNormals(VertexFormat format) {
+    return format == VertexFormat::PositionNormal3f;
+}
+
+// Planes of width * height floats in a chunk's noise field: the normalized fBm, then for
+// formats with normals its derivatives along world x and along world z
+int noiseFieldPlanes(VertexFormat format) {
+    return vertexFormatHasNormals(format) ? 3 : 1;
+}
+
+// Allocates the storage for the chunk's format and sets the height decode range
+void allocateTerrainData(TerrainData& terrain, VertexFormat format, int width, int height, float heightScale) {
+    size_t count = (size_t)width * height;
+    terrain.format = format;
+    switch (format) {
+    case VertexFormat::Position3f:
+        terrain.vertices.resize(count * 3);
+        break;
+    case VertexFormat::PositionNormal3f:
+        terrain.vertices.resize(count * 6);
+        break;
+    case VertexFormat::HeightFloat:
+        terrain.heights.resize(count);
+        break;
+    case VertexFormat::HeightUnorm16:
+        terrain.packedHeights.resize(count);
+        // Normalized fBm stays within [-1, 1] and the falloff only shrinks it
+        terrain.heightBias = -heightScale;
+        terrain.heightRange = 2.0f * heightScale;
+        break;
+    }
+}
+
 // Function to calculate a smooth falloff factor
 float calculateFalloffFactor(int x, int z, int width, int height) {
     float edgeDistanceX = std::min(x, width - 1 - x) / (float)(width / 2);
@@ -21,67 +87,489 @@ float calculateFalloffFactor(int x, int z, int width, int height) {
     return 1 / (exp(-edgeDistance) + 1); // Sigmoid falloff
 }
 
-TerrainData generateTerrain(int width, int height, float scale, float seed, int octaves, float persistence, float frequency, float lacunarity, float heightScale, float xOffset = 0.0f, float zOffset = 0.0f) {
-    TerrainData terrain;
-    terrain.vertices.reserve(width * height * 3); // Reserve memory for vertices
+// calculateFalloffFactor and its derivatives along x and z, treating the vertex indices as
+// continuous. Only the nearer edge moves the factor; at the creases where two edges are equally
+// near, x wins.
+float calculateFalloffGradient(int x, int z, int width, int height, float& dFactorDx, float& dFactorDz) {
+    float factor = calculateFalloffFactor(x, z, width, height);
+    float edgeDistanceX = std::min(x, width - 1 - x) / (float)(width / 2);
+    float edgeDistanceZ = std::min(z, height - 1 - z) / (float)(height / 2);
+    // d sigmoid(d) = sigmoid(d) * (1 - sigmoid(d)) dd
+    float slope = factor * (1.0f - factor);
+    dFactorDx = dFactorDz = 0.0f;
+    if (edgeDistanceX <= edgeDistanceZ) {
+        if (width / 2 > 0 && 2 * x != width - 1) dFactorDx = slope * (2 * x < width - 1 ? 1.0f : -1.0f) / (float)(width / 2);
+    }
+    else if (height / 2 > 0 && 2 * z != height - 1) {
+        dFactorDz = slope * (2 * z < height - 1 ? 1.0f : -1.0f) / (float)(height / 2);
+    }
+    return factor;
+}
+
+// Everything needed to fill any subset of a chunk's vertex rows, set up once per chunk
+struct TerrainRowJob {
+    FbmRowParams row;
+    FbmRowFn fbmRow;
+    FbmRowGradFn fbmRowGrad;    // Same octaves with derivatives, for formats with normals
+    const NoiseGraph* graph;    // Recipe replacing the fBm when set, see noise_graph.h
+    FractalType fractal;
+    int width, height;
+    float zOffset;
+    float heightScale;
+    bool falloff;       // Fade heights out towards the chunk edges
+    VertexFormat format;
+};
+
+TerrainRowJob makeTerrainRowJob(int width, int height, float scale, float seed, int octaves, float persistence, float frequency, float lacunarity, float heightScale, float xOffset, float zOffset, NoiseMode mode, VertexFormat format, FractalType fractal = FractalType::Fbm) {
+    TerrainRowJob job;
+    job.row.xOffset = xOffset;
+    job.row.halfWidth = width / 2.0f;
+    job.row.scale = scale;
+    job.row.seed = seed;
+    job.row.count = width;
+    job.row.mode = mode;
+    job.row.firstOctave = 0;
+    job.row.tables = makeFbmTables(octaves, persistence, frequency, lacunarity);
+    job.fbmRow = getFbmRowKernel(activeSimdLevel(), mode, job.row.tables.octaves, fractal);
+    job.fbmRowGrad = getFbmRowGradKernel(activeSimdLevel(), mode, job.row.tables.octaves, fractal);
+    job.graph = nullptr;
+    job.fractal = fractal;
+    job.width = width;
+    job.height = height;
+    job.zOffset = zOffset;
+    job.heightScale = heightScale;
+    job.falloff = true;
+    job.format = format;
+    return job;
+}
+
+// Culls the job's octaves with cullFbmOctaves and switches to the kernel for the rest. An octave
+// of the ridged and hybrid multifractals spans twice its amplitude after normalization.
+int cullTerrainOctaves(TerrainRowJob& job, float sampleSpacing, float tolerance) {
+    bool doubled = job.fractal == FractalType::Ridged || job.fractal == FractalType::Hybrid;
+    int octaves = cullFbmOctaves(job.row.tables, job.row.scale, sampleSpacing, job.heightScale * (doubled ? 2.0f : 1.0f), tolerance);
+    job.fbmRow = getFbmRowKernel(activeSimdLevel(), job.row.mode, octaves, job.fractal);
+    job.fbmRowGrad = getFbmRowGradKernel(activeSimdLevel(), job.row.mode, octaves, job.fractal);
+    return octaves;
+}
+
+float terrainRowWorldZ(const TerrainRowJob& job, int z) {
+    // Adjust world positions with global offsets
+    return ((float)z + job.zOffset) - (job.height / 2.0f);
+}
 
-    for (int z = 0; z < height; z++) {
+// Turns one row of normalized noise into heights and stores them in the job's format. Formats
+// with normals also need the row's noise derivatives along world x and z (noiseDx, noiseDz),
+// the others take null. rowHeights is width floats of scratch space.
+void shapeTerrainRow(const TerrainRowJob& job, TerrainData& terrain, int z, const float* noise, const float* noiseDx, const float* noiseDz, float* rowHeights) {
+    const int width = job.width;
+    const int height = job.height;
+
+    for (int x = 0; x < width; x++) {
+        // Scale the normalized height
+        float heightValue = noise[x] * job.heightScale;
+
+        // Apply falloff factor for smooth edges
+        float falloffFactor = job.falloff ? calculateFalloffFactor(x, z, width, height) : 1.0f;
+        rowHeights[x] = heightValue * falloffFactor;
+    }
+
+    // Store the vertex data
+    size_t first = (size_t)z * width;
+    switch (job.format) {
+    case VertexFormat::Position3f: {
+        float worldZ = terrainRowWorldZ(job, z);
+        float* out = terrain.vertices.data() + first * 3;
+        for (int x = 0; x < width; x++) {
+            float worldX = ((float)x + job.row.xOffset) - (width / 2.0f);
+            out[x * 3 + 0] = worldX;        // x-coordinate
+            out[x * 3 + 1] = rowHeights[x]; // y-coordinate (height)
+            out[x * 3 + 2] = worldZ;        // z-coordinate
+        }
+        break;
+    }
+    case VertexFormat::PositionNormal3f: {
+        float worldZ = terrainRowWorldZ(job, z);
+        float* out = terrain.vertices.data() + first * 6;
         for (int x = 0; x < width; x++) {
-            // Adjust world positions with global offsets
-            float worldX = ((float)x + xOffset) - (width / 2.0f);
-            float worldZ = ((float)z + zOffset) - (height / 2.0f);
+            float worldX = ((float)x + job.row.xOffset) - (width / 2.0f);
+            out[x * 6 + 0] = worldX;
+            out[x * 6 + 1] = rowHeights[x];
+            out[x * 6 + 2] = worldZ;
+
+            // y = heightScale * noise * falloff, so the slope is the product rule over the
+            // analytic noise derivatives; vertices are one world unit apart
+            float falloffFactor = 1.0f, dFalloffDx = 0.0f, dFalloffDz = 0.0f;
+            if (job.falloff) falloffFactor = calculateFalloffGradient(x, z, width, height, dFalloffDx, dFalloffDz);
+            float slopeX = job.heightScale * (noiseDx[x] * falloffFactor + noise[x] * dFalloffDx);
+            float slopeZ = job.heightScale * (noiseDz[x] * falloffFactor + noise[x] * dFalloffDz);
+            float invLength = 1.0f / std::sqrt(slopeX * slopeX + 1.0f + slopeZ * slopeZ);
+            out[x * 6 + 3] = -slopeX * invLength;
+            out[x * 6 + 4] = invLength;
+            out[x * 6 + 5] = -slopeZ * invLength;
+        }
+        break;
+    }
+    case VertexFormat::HeightFloat:
+        std::memcpy(terrain.heights.data() + first, rowHeights, width * sizeof(float));
+        break;
+    case VertexFormat::HeightUnorm16: {
+        uint16_t* out = terrain.packedHeights.data() + first;
+        float toUnit = terrain.heightRange > 0.0f ? 1.0f / terrain.heightRange : 0.0f;
+        for (int x = 0; x < width; x++) {
+            float unit = (rowHeights[x] - terrain.heightBias) * toUnit;
+            unit = std::min(std::max(unit, 0.0f), 1.0f);
+            out[x] = (uint16_t)(unit * 65535.0f + 0.5f);
+        }
+        break;
+    }
+    }
+}
 
-            // Accumulate multiple octaves of noise
-            float heightValue = 0.0f;
-            float amplitude = 1.0f;
-            float maxValue = 0.0f;
+// Normalized fBm of vertices [xBegin, xEnd) of row z only. Shifting the row's x offset by
+// xBegin gives each vertex the same world x as the full row, exactly for integer offsets.
+void generateNoiseSpan(const TerrainRowJob& job, float* field, int z, int xBegin, int xEnd) {
+    if (xEnd <= xBegin) return;
+    FbmRowParams row = job.row;
+    row.worldZ = terrainRowWorldZ(job, z);
+    row.xOffset += (float)xBegin;
+    row.count = xEnd - xBegin;
+    size_t first = (size_t)z * job.width + xBegin;
+    size_t plane = (size_t)job.width * job.height;
+    bool normals = vertexFormatHasNormals(job.format);
+    if (job.graph) {
+        evaluateNoiseGraphRow(*job.graph, row, field + first, normals ? field + plane + first : nullptr, normals ? field + 2 * plane + first : nullptr);
+    }
+    else if (normals) {
+        job.fbmRowGrad(row, field + first, field + plane + first, field + 2 * plane + first);
+    }
+    else {
+        job.fbmRow(row, field + first);
+    }
+}
 
-            for (int o = 0; o < octaves; o++) {
-                float currentFreq = frequency * pow(lacunarity, o); // Adjust frequency using lacunarity
-                float sampleX = (worldX / scale) * currentFreq;
-                float sampleZ = (worldZ / scale) * currentFreq;
+// Normalized fBm of rows [zBegin, zEnd) into field, width values per row, with the derivative
+// planes after it for formats with normals (see noiseFieldPlanes). This is the only expensive
+// part of a chunk; keeping the field lets heightScale, falloff and vertex format changes skip it.
+void generateNoiseRows(const TerrainRowJob& job, float* field, int zBegin, int zEnd) {
+    for (int z = zBegin; z < zEnd; z++) {
+        generateNoiseSpan(job, field, z, 0, job.width);
+    }
+}
+
+// Largest vertex step at which one octave can be sampled and bicubically upsampled while its
+// height error stays under tolerance / octaves. Catmull-Rom over gradient noise sampled every
+// h lattice cells errs by about 4 * h^3 of the octave's amplitude; h is kept to at most half a
+// cell. Returns 1 when the octave needs every vertex.
+int coarseOctaveStep(const FbmTables& tables, int octave, float scale, float heightScale, float tolerance) {
+    float heightAmplitude = tables.amplitude[octave] / tables.maxValue * std::fabs(heightScale);
+    float cellsPerVertex = tables.frequency[octave] / scale;
+    if (tables.octaves <= 0 || !(cellsPerVertex > 0.0f)) return 1;
+    float allowed = tolerance / tables.octaves;
+    float h = heightAmplitude > 0.0f ? std::cbrt(allowed / (4.0f * heightAmplitude)) : 0.5f;
+    h = std::min(h, 0.5f);
+    int step = (int)(h / cellsPerVertex);
+    return std::max(1, std::min(step, 64));
+}
 
-                // Incorporate seed for consistent randomness
-                float sampleY = seed * 0.5f * currentFreq;
+// Catmull-Rom weights for a point t of the way from node 1 to node 2
+void catmullRomWeights(float t, float* w) {
+    float t2 = t * t, t3 = t2 * t;
+    w[0] = 0.5f * (-t3 + 2.0f * t2 - t);
+    w[1] = 0.5f * (3.0f * t3 - 5.0f * t2 + 2.0f);
+    w[2] = 0.5f * (-3.0f * t3 + 4.0f * t2 + t);
+    w[3] = 0.5f * (t3 - t2);
+}
 
-                float noiseValue = glm::perlin(glm::vec3(sampleX, sampleY, sampleZ));
-                heightValue += noiseValue * amplitude;
+// For each of count vertices starting at grid position offset, the first of the 4 coarse nodes
+// around it (relative to the first node, floor(offset / step) - 1) and their weights
+void coarseNodeWeights(float offset, int count, int step, std::vector<int>& first, std::vector<float>& weights) {
+    int firstNode = (int)std::floor(offset / step) - 1;
+    first.resize(count);
+    weights.resize((size_t)count * 4);
+    for (int i = 0; i < count; i++) {
+        float position = i + offset;
+        int node = (int)std::floor(position / step);
+        first[i] = node - 1 - firstNode;
+        catmullRomWeights((position - node * (float)step) / step, &weights[(size_t)i * 4]);
+    }
+}
 
-                maxValue += amplitude;
-                amplitude *= persistence; // Reduce amplitude with persistence
+// Normalized fBm of the job's whole grid into field, with each octave sampled only as densely as
+// coarseOctaveStep allows and upsampled with Catmull-Rom. Octaves that need every vertex are
+// evaluated at full resolution as usual. Coarse nodes sit at multiples of the step in grid
+// position (vertex index plus offset), so neighbouring chunks interpolate the same nodes and
+// still agree on their shared edges. For formats with normals the nodes' derivatives are
+// upsampled the same way into the derivative planes. Returns the number of single-octave noise
+// evaluations. fBm only: the multifractals weight each octave by the ones before it.
+size_t generateNoiseFieldCoarse(const TerrainRowJob& job, float tolerance, float* field) {
+    const int width = job.width;
+    const int height = job.height;
+    const FbmTables& tables = job.row.tables;
+    const size_t count = (size_t)width * height;
+    const int planes = noiseFieldPlanes(job.format);
+    size_t evaluations = 0;
+    std::vector<float> sum(count * planes, 0.0f);
+    std::vector<float> row((size_t)width * planes);
+
+    int o = 0;
+    while (o < tables.octaves) {
+        int step = coarseOctaveStep(tables, o, job.row.scale, job.heightScale, tolerance);
+
+        if (step == 1) {
+            // Run of consecutive full resolution octaves, one kernel call per row
+            int run = 1;
+            while (o + run < tables.octaves && coarseOctaveStep(tables, o + run, job.row.scale, job.heightScale, tolerance) == 1) run++;
+            FbmRowParams params = job.row;
+            params.tables = sliceFbmTables(tables, o, run);
+            params.firstOctave = job.row.firstOctave + o;
+            FbmRowFn kernel = getFbmRowKernel(activeSimdLevel(), params.mode, run);
+            FbmRowGradFn gradKernel = getFbmRowGradKernel(activeSimdLevel(), params.mode, run);
+            for (int z = 0; z < height; z++) {
+                params.worldZ = terrainRowWorldZ(job, z);
+                if (planes > 1) gradKernel(params, row.data(), row.data() + width, row.data() + 2 * width);
+                else kernel(params, row.data());
+                for (int p = 0; p < planes; p++) {
+                    const float* in = row.data() + (size_t)p * width;
+                    float* out = sum.data() + p * count + (size_t)z * width;
+                    for (int x = 0; x < width; x++) out[x] += in[x];
+                }
             }
+            evaluations += count * run;
+            o += run;
+            continue;
+        }
+
+        // Nodes one step outside the grid on each side so every vertex has 4 around it
+        int nodeX0 = (int)std::floor(job.row.xOffset / step) - 1;
+        int nodeZ0 = (int)std::floor(job.zOffset / step) - 1;
+        int nodesX = (int)std::floor((job.row.xOffset + width - 1) / step) + 2 - nodeX0 + 1;
+        int nodesZ = (int)std::floor((job.zOffset + height - 1) / step) + 2 - nodeZ0 + 1;
+
+        // Node i of a coarse row sits at grid position (nodeX0 + i) * step. Dividing scale,
+        // halfWidth and worldZ by step lets the row kernel walk the nodes one unit at a time;
+        // its derivatives are then per node and get divided by step again.
+        FbmRowParams params = job.row;
+        params.tables = sliceFbmTables(tables, o, 1);
+        params.firstOctave = job.row.firstOctave + o;
+        params.scale = job.row.scale / step;
+        params.xOffset = (float)nodeX0;
+        params.halfWidth = job.row.halfWidth / step;
+        params.count = nodesX;
+        FbmRowFn kernel = getFbmRowKernel(activeSimdLevel(), params.mode, 1);
+        FbmRowGradFn gradKernel = getFbmRowGradKernel(activeSimdLevel(), params.mode, 1);
+
+        std::vector<int> firstX, firstZ;
+        std::vector<float> weightsX, weightsZ;
+        coarseNodeWeights(job.row.xOffset, width, step, firstX, weightsX);
+        coarseNodeWeights(job.zOffset, height, step, firstZ, weightsZ);
+
+        // Evaluate each node row and upsample it along x straight away
+        const size_t rowsPlane = (size_t)nodesZ * width;
+        std::vector<float> nodes((size_t)nodesX * planes);
+        std::vector<float> rows(rowsPlane * planes);
+        for (int j = 0; j < nodesZ; j++) {
+            params.worldZ = ((nodeZ0 + j) * (float)step - height / 2.0f) / step;
+            if (planes > 1) gradKernel(params, nodes.data(), nodes.data() + nodesX, nodes.data() + 2 * nodesX);
+            else kernel(params, nodes.data());
+            for (int p = 0; p < planes; p++) {
+                float* out = rows.data() + p * rowsPlane + (size_t)j * width;
+                float unit = p == 0 ? 1.0f : 1.0f / step;
+                for (int x = 0; x < width; x++) {
+                    const float* n = nodes.data() + (size_t)p * nodesX + firstX[x];
+                    const float* w = &weightsX[(size_t)x * 4];
+                    out[x] = (n[0] * w[0] + n[1] * w[1] + n[2] * w[2] + n[3] * w[3]) * unit;
+                }
+            }
+        }
+        evaluations += (size_t)nodesX * nodesZ;
+
+        // Then along z into the sum
+        for (int p = 0; p < planes; p++) {
+            for (int z = 0; z < height; z++) {
+                const float* r0 = rows.data() + p * rowsPlane + (size_t)firstZ[z] * width;
+                const float* w = &weightsZ[(size_t)z * 4];
+                float* out = sum.data() + p * count + (size_t)z * width;
+                for (int x = 0; x < width; x++) {
+                    out[x] += r0[x] * w[0] + r0[x + width] * w[1] + r0[x + 2 * width] * w[2] + r0[x + 3 * width] * w[3];
+                }
+            }
+        }
+        o++;
+    }
 
-            // Normalize and scale the height
-            heightValue = (heightValue / maxValue) * heightScale;
+    for (size_t i = 0; i < count * planes; i++) {
+        field[i] = tables.octaves > 0 ? sum[i] / tables.maxValue : 0.0f;
+    }
+    return evaluations;
+}
 
-            // Apply falloff factor for smooth edges
-            float falloffFactor = calculateFalloffFactor(x, z, width, height);
-            heightValue *= falloffFactor;
+// Vertices of rows [zBegin, zEnd) from a field written by generateNoiseRows
+void shapeTerrainRows(const TerrainRowJob& job, const float* field, TerrainData& terrain, int zBegin, int zEnd) {
+    std::vector<float> rowHeights(job.width);
+    size_t plane = (size_t)job.width * job.height;
+    bool normals = vertexFormatHasNormals(job.format);
+    for (int z = zBegin; z < zEnd; z++) {
+        const float* noise = field + (size_t)z * job.width;
+        shapeTerrainRow(job, terrain, z, noise, normals ? noise + plane : nullptr, normals ? noise + 2 * plane : nullptr, rowHeights.data());
+    }
+}
 
-            // Store the vertex data
-            terrain.vertices.push_back(worldX);     // x-coordinate
-            terrain.vertices.push_back(heightValue); // y-coordinate (height)
-            terrain.vertices.push_back(worldZ);     // z-coordinate
+// Writes the vertices of rows [zBegin, zEnd) in the job's format. Rows don't depend on each
+// other, so any split of the rows across threads gives the same bytes as the serial loop.
+void generateTerrainRows(const TerrainRowJob& job, TerrainData& terrain, int zBegin, int zEnd) {
+    bool normals = vertexFormatHasNormals(job.format);
+    std::vector<float> rowNoise(job.width);
+    std::vector<float> rowDx(normals ? job.width : 0), rowDz(normals ? job.width : 0);
+    std::vector<float> rowHeights(job.width);
+    FbmRowParams row = job.row;
+
+    for (int z = zBegin; z < zEnd; z++) {
+        // Normalized fBm for the whole row, evaluated several vertices at a time, with its
+        // derivatives from the same noise lookups when the format wants normals
+        row.worldZ = terrainRowWorldZ(job, z);
+        if (job.graph) {
+            evaluateNoiseGraphRow(*job.graph, row, rowNoise.data(), normals ? rowDx.data() : nullptr, normals ? rowDz.data() : nullptr);
+            shapeTerrainRow(job, terrain, z, rowNoise.data(), normals ? rowDx.data() : nullptr, normals ? rowDz.data() : nullptr, rowHeights.data());
+        }
+        else if (normals) {
+            job.fbmRowGrad(row, rowNoise.data(), rowDx.data(), rowDz.data());
+            shapeTerrainRow(job, terrain, z, rowNoise.data(), rowDx.data(), rowDz.data(), rowHeights.data());
+        }
+        else {
+            job.fbmRow(row, rowNoise.data());
+            shapeTerrainRow(job, terrain, z, rowNoise.data(), nullptr, nullptr, rowHeights.data());
         }
     }
+}
+
+// Index layouts for a width x height grid
+enum class IndexLayout {
+    TriangleList,   // 6 indices per quad
+    TriangleStrip   // one strip per quad row, rows separated by a primitive restart index
+};
 
-    // Generate indices for triangle-based mesh
-    for (int z = 0; z < height - 1; z++) {
+size_t terrainIndexCount(int width, int height, IndexLayout layout = IndexLayout::TriangleList) {
+    if (width < 2 || height < 2) return 0;
+    if (layout == IndexLayout::TriangleStrip) return (size_t)(height - 1) * (width * 2 + 1) - 1;
+    return (size_t)(width - 1) * (height - 1) * 6;
+}
+
+// 16-bit indices cover grids up to 65536 vertices. Strips also need one value free for the
+// restart index, which is the largest value of the index type.
+bool terrainFitsShortIndices(int width, int height, IndexLayout layout) {
+    size_t vertices = (size_t)width * height;
+    return layout == IndexLayout::TriangleStrip ? vertices <= 0xFFFF : vertices <= 0x10000;
+}
+
+// Writes the triangle indices for quad rows [zBegin, zEnd), zEnd <= height - 1
+template<class Index>
+void generateTerrainIndexRows(int width, Index* indices, int zBegin, int zEnd) {
+    for (int z = zBegin; z < zEnd; z++) {
+        Index* out = indices + (size_t)z * (width - 1) * 6;
         for (int x = 0; x < width - 1; x++) {
             int topLeft = z * width + x;
             int topRight = topLeft + 1;
             int bottomLeft = (z + 1) * width + x;
             int bottomRight = bottomLeft + 1;
 
-            terrain.indices.push_back(topLeft);
-            terrain.indices.push_back(bottomLeft);
-            terrain.indices.push_back(topRight);
+            *out++ = (Index)topLeft;
+            *out++ = (Index)bottomLeft;
+            *out++ = (Index)topRight;
 
-            terrain.indices.push_back(topRight);
-            terrain.indices.push_back(bottomLeft);
-            terrain.indices.push_back(bottomRight);
+            *out++ = (Index)topRight;
+            *out++ = (Index)bottomLeft;
+            *out++ = (Index)bottomRight;
         }
     }
+}
+
+// Same triangles as generateTerrainIndexRows, as strips: top/bottom vertex pairs left to right.
+// The strip's alternating winding gives (TL, BL, TR) then (TR, BL, BR) for every quad, exactly
+// the list order.
+template<class Index>
+void generateTerrainStripRows(int width, Index* indices, int zBegin, int zEnd, Index restartIndex) {
+    for (int z = zBegin; z < zEnd; z++) {
+        // Every strip after the first starts with a restart
+        Index* out = indices + (z == 0 ? 0 : (size_t)z * (width * 2 + 1) - 1);
+        if (z > 0) *out++ = restartIndex;
+        for (int x = 0; x < width; x++) {
+            *out++ = (Index)(z * width + x);
+            *out++ = (Index)((z + 1) * width + x);
+        }
+    }
+}
+
+template<class Index>
+std::vector<Index> generateTerrainIndices(int width, int height, IndexLayout layout = IndexLayout::TriangleList) {
+    std::vector<Index> indices(terrainIndexCount(width, height, layout));
+    if (indices.empty()) return indices;
+    if (layout == IndexLayout::TriangleStrip) {
+        generateTerrainStripRows<Index>(width, indices.data(), 0, height - 1, (Index)~(Index)0);
+    }
+    else {
+        generateTerrainIndexRows<Index>(width, indices.data(), 0, height - 1);
+    }
+    return indices;
+}
+
+// Generate indices for triangle-based mesh
+std::vector<unsigned int> generateTerrainIndices(int width, int height) {
+    return generateTerrainIndices<unsigned int>(width, height, IndexLayout::TriangleList);
+}
+
+// The generator parameters every chunk is built from, as set in the menu
+struct TerrainSettings {
+    int width = 32;
+    int height = 32;
+    float scale = 50.0f;
+    float seed = 0.0f;          // World seed, shared by every chunk
+    int octaves = 4;
+    float persistence = 0.5f;
+    float frequency = 2.0f;
+    float lacunarity = 2.0f;
+    float heightScale = 10.0f;
+    bool falloff = true;
+    bool octaveCulling = false;     // Skip octaves too fine or too faint to see, see cullFbmOctaves
+    float cullTolerance = 0.05f;    // Height error allowed by octave culling, world units
+    bool coarseOctaves = false;     // Sample smooth octaves on coarser grids, see generateNoiseFieldCoarse
+    float coarseTolerance = 0.02f;  // Height error allowed by coarse sampling, world units
+    NoiseMode mode = NoiseMode::Perlin3D;
+    FractalType fractal = FractalType::Fbm; // Coarse octaves only apply to fBm
+    VertexFormat format = VertexFormat::Position3f;
+    // Terrain recipe replacing the fBm sliders above when set; culling and coarse octaves don't
+    // apply to it. Shared, since every chunk job keeps a copy of the settings.
+    std::shared_ptr<const NoiseGraph> recipe;
+};
+
+// Largest integer world seed; every integer up to it is exactly representable as the float seed
+const int MAX_WORLD_SEED = 1 << 24;
+
+// Heights depend on the arguments and nothing else: the same seed, settings and offsets give the
+// same bytes whatever the thread count, row split, chunk order or SIMD level (no instruction
+// set uses FMA, see noise_simd.h). The normalized noise is plain float arithmetic, so it also
+// matches across machines built without fast-math; the edge falloff goes through std::exp, so
+// final heights are only guaranteed to match under the same C runtime.
+TerrainData generateTerrain(int width, int height, float scale, float seed, int octaves, float persistence, float frequency, float lacunarity, float heightScale, float xOffset = 0.0f, float zOffset = 0.0f, NoiseMode mode = NoiseMode::Perlin3D, VertexFormat format = VertexFormat::Position3f) {
+    TerrainData terrain;
+    allocateTerrainData(terrain, format, width, height, heightScale); // Pre-size so rows can be written in place
+
+    TerrainRowJob job = makeTerrainRowJob(width, height, scale, seed, octaves, persistence, frequency, lacunarity, heightScale, xOffset, zOffset, mode, format);
+    generateTerrainRows(job, terrain, 0, height);
+
+    return terrain;
+}
+
+// Same output as generateTerrain, byte for byte, with the rows split across the shared
+// thread pool. threadCount = 0 uses every hardware thread.
+TerrainData generateTerrainParallel(int width, int height, float scale, float seed, int octaves, float persistence, float frequency, float lacunarity, float heightScale, float xOffset = 0.0f, float zOffset = 0.0f, NoiseMode mode = NoiseMode::Perlin3D, VertexFormat format = VertexFormat::Position3f, int threadCount = 0) {
+    TerrainData terrain;
+    allocateTerrainData(terrain, format, width, height, heightScale);
+
+    TerrainRowJob job = makeTerrainRowJob(width, height, scale, seed, octaves, persistence, frequency, lacunarity, heightScale, xOffset, zOffset, mode, format);
+    sharedThreadPool().parallelFor(height, threadCount, [&](int zBegin, int zEnd) {
+        generateTerrainRows(job, terrain, zBegin, zEnd);
+    });
 
     return terrain;
 }
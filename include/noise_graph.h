@@ -0,0 +1,518 @@
+#ifndef NOISE_GRAPH_H
+#define NOISE_GRAPH_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "noise_simd.h"
+
+// Terrain recipes: a small graph of noise and math nodes, written as text one node per line,
+//
+//     # comment
+//     name = op input input ... key=value ...
+//
+// Inputs are earlier node names or numbers. The last node is the recipe's output, the terrain's
+// normalized height before height scale and falloff. Ops and their keys:
+//
+//     fbm      octaves=4 frequency=1 persistence=0.5 lacunarity=2 mode=perlin3d seed=0
+//              warpx=node warpz=node warp=0       normalized fBm, sampled at x + warp * warpx,
+//                                                  z + warp * warpz when warp nodes are given
+//     ridged, billow, hybrid                       the multifractals, same keys as fbm
+//     const    value=0
+//     add a b, sub a b, mul a b, min a b, max a b
+//     abs a
+//     scale a  factor=1 offset=0                  a * factor + offset
+//     clamp a  min=-1 max=1
+//     lerp a b t                                   a + (b - a) * t
+//     blend a b mask  lo=0 hi=1                    lerp with t = smoothstep(lo, hi, mask)
+//     terrace a  steps=8 sharpness=4               steps flat levels, sharpness >= 1
+//
+// mode is one of perlin3d, seeded2d, simplex3d, opensimplex2, value2d. seed is added to the
+// world seed. frequency is relative to the terrain's Scale, like the Frequency slider.
+//
+// A compiled graph runs as one fused loop: every node is evaluated for a short span of a row
+// into a small register file that stays in cache, and only the output reaches the field. No
+// node ever writes a full-size buffer. Derivatives along x and z are carried through every
+// node for the formats with normals.
+
+enum class GraphOp {
+    Constant, Fbm, Add, Subtract, Multiply, Min, Max, Abs, Scale, Clamp, Lerp, Blend, Terrace
+};
+
+struct GraphNode {
+    GraphOp op;
+    int inputs[3];          // Node indices, -1 when unused
+    float params[2];        // Constant: value. Scale: factor, offset. Clamp: min, max.
+                            // Blend: lo, hi. Terrace: steps, sharpness.
+    // Fbm only
+    FbmTables tables;
+    NoiseMode mode;
+    FractalType fractal;
+    float seedOffset;
+    int warpX, warpZ;       // Node indices, -1 when unwarped
+    float warpAmount;
+    int reg;                // Register the node's result is written to
+};
+
+struct NoiseGraph {
+    std::string source;             // Text it was compiled from, part of the disk cache key
+    std::vector<GraphNode> nodes;   // Evaluation order, the last one is the output
+    int registers = 0;
+    int octaves = 0;                // Octaves of all fbm nodes together
+};
+
+// Samples per register, the length of the spans a row is evaluated in
+const int NOISE_GRAPH_SPAN = 64;
+
+bool parseGraphNoiseMode(const std::string& name, NoiseMode& mode) {
+    static const char* names[NOISE_MODE_COUNT] = { "perlin3d", "seeded2d", "simplex3d", "opensimplex2", "value2d" };
+    for (int m = 0; m < NOISE_MODE_COUNT; m++) {
+        if (name == names[m]) {
+            mode = (NoiseMode)m;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parseGraphNumber(const std::string& text, float& value) {
+    if (text.empty()) return false;
+    char* end = nullptr;
+    value = std::strtof(text.c_str(), &end);
+    return end == text.c_str() + text.size();
+}
+
+// Compiles recipe text into graph. Returns false with a message naming the line on any error.
+// Nodes the output doesn't depend on are dropped, and registers are reused once the last node
+// reading them has run.
+bool compileNoiseGraph(const std::string& text, NoiseGraph& graph, std::string& error) {
+    struct OpInfo {
+        const char* name;
+        GraphOp op;
+        int inputs;
+        const char* keys[2];
+        float defaults[2];
+        FractalType fractal;
+    };
+    static const OpInfo ops[] = {
+        { "const", GraphOp::Constant, 0, { "value", nullptr }, { 0.0f, 0.0f }, FractalType::Fbm },
+        { "fbm", GraphOp::Fbm, 0, { nullptr, nullptr }, { 0.0f, 0.0f }, FractalType::Fbm },
+        { "ridged", GraphOp::Fbm, 0, { nullptr, nullptr }, { 0.0f, 0.0f }, FractalType::Ridged },
+        { "billow", GraphOp::Fbm, 0, { nullptr, nullptr }, { 0.0f, 0.0f }, FractalType::Billow },
+        { "hybrid", GraphOp::Fbm, 0, { nullptr, nullptr }, { 0.0f, 0.0f }, FractalType::Hybrid },
+        { "add", GraphOp::Add, 2, { nullptr, nullptr }, { 0.0f, 0.0f }, FractalType::Fbm },
+        { "sub", GraphOp::Subtract, 2, { nullptr, nullptr }, { 0.0f, 0.0f }, FractalType::Fbm },
+        { "mul", GraphOp::Multiply, 2, { nullptr, nullptr }, { 0.0f, 0.0f }, FractalType::Fbm },
+        { "min", GraphOp::Min, 2, { nullptr, nullptr }, { 0.0f, 0.0f }, FractalType::Fbm },
+        { "max", GraphOp::Max, 2, { nullptr, nullptr }, { 0.0f, 0.0f }, FractalType::Fbm },
+        { "abs", GraphOp::Abs, 1, { nullptr, nullptr }, { 0.0f, 0.0f }, FractalType::Fbm },
+        { "scale", GraphOp::Scale, 1, { "factor", "offset" }, { 1.0f, 0.0f }, FractalType::Fbm },
+        { "clamp", GraphOp::Clamp, 1, { "min", "max" }, { -1.0f, 1.0f }, FractalType::Fbm },
+        { "lerp", GraphOp::Lerp, 3, { nullptr, nullptr }, { 0.0f, 0.0f }, FractalType::Fbm },
+        { "blend", GraphOp::Blend, 3, { "lo", "hi" }, { 0.0f, 1.0f }, FractalType::Fbm },
+        { "terrace", GraphOp::Terrace, 1, { "steps", "sharpness" }, { 8.0f, 4.0f }, FractalType::Fbm },
+    };
+
+    std::vector<GraphNode> nodes;
+    std::map<std::string, int> names;
+    std::istringstream lines(text);
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(lines, line)) {
+        lineNumber++;
+        std::string::size_type comment = line.find('#');
+        if (comment != std::string::npos) line.erase(comment);
+        std::istringstream tokens(line);
+        std::string name, equals, opName;
+        if (!(tokens >> name)) continue;    // Blank or comment only
+
+        std::ostringstream where;
+        where << "line " << lineNumber << ": ";
+        if (!(tokens >> equals) || equals != "=" || !(tokens >> opName)) {
+            error = where.str() + "expected 'name = op ...'";
+            return false;
+        }
+        if (names.count(name)) {
+            error = where.str() + "'" + name + "' is already defined";
+            return false;
+        }
+        const OpInfo* info = nullptr;
+        for (const OpInfo& candidate : ops) {
+            if (opName == candidate.name) info = &candidate;
+        }
+        if (!info) {
+            error = where.str() + "unknown op '" + opName + "'";
+            return false;
+        }
+
+        GraphNode node = {};
+        node.op = info->op;
+        node.inputs[0] = node.inputs[1] = node.inputs[2] = -1;
+        node.params[0] = info->defaults[0];
+        node.params[1] = info->defaults[1];
+        node.mode = NoiseMode::Perlin3D;
+        node.fractal = info->fractal;
+        node.warpX = node.warpZ = -1;
+        int octaves = 4;
+        float frequency = 1.0f, persistence = 0.5f, lacunarity = 2.0f;
+
+        // A node name or a number, numbers become a constant node of their own
+        auto resolve = [&](const std::string& token, int& index) {
+            float number;
+            if (parseGraphNumber(token, number)) {
+                GraphNode constant = {};
+                constant.op = GraphOp::Constant;
+                constant.inputs[0] = constant.inputs[1] = constant.inputs[2] = -1;
+                constant.warpX = constant.warpZ = -1;
+                constant.params[0] = number;
+                nodes.push_back(constant);
+                index = (int)nodes.size() - 1;
+                return true;
+            }
+            std::map<std::string, int>::const_iterator it = names.find(token);
+            if (it == names.end()) return false;
+            index = it->second;
+            return true;
+        };
+
+        int inputCount = 0;
+        std::string token;
+        while (tokens >> token) {
+            std::string::size_type split = token.find('=');
+            if (split == std::string::npos) {
+                if (inputCount == info->inputs) {
+                    error = where.str() + "too many inputs for " + opName;
+                    return false;
+                }
+                if (!resolve(token, node.inputs[inputCount])) {
+                    error = where.str() + "'" + token + "' isn't defined above";
+                    return false;
+                }
+                inputCount++;
+                continue;
+            }
+
+            std::string key = token.substr(0, split), value = token.substr(split + 1);
+            float number = 0.0f;
+            bool isNumber = parseGraphNumber(value, number);
+            bool known = true, valid = isNumber;
+            if (info->keys[0] && key == info->keys[0]) node.params[0] = number;
+            else if (info->keys[1] && key == info->keys[1]) node.params[1] = number;
+            else if (node.op != GraphOp::Fbm) known = false;
+            else if (key == "octaves") octaves = (int)number;
+            else if (key == "frequency") frequency = number;
+            else if (key == "persistence") persistence = number;
+            else if (key == "lacunarity") lacunarity = number;
+            else if (key == "seed") node.seedOffset = std::floor(number);
+            else if (key == "warp") node.warpAmount = number;
+            else if (key == "mode") valid = parseGraphNoiseMode(value, node.mode);
+            else if (key == "warpx") valid = resolve(value, node.warpX);
+            else if (key == "warpz") valid = resolve(value, node.warpZ);
+            else known = false;
+            if (!known) {
+                error = where.str() + "unknown key '" + key + "' for " + opName;
+                return false;
+            }
+            if (!valid) {
+                error = where.str() + "bad value '" + value + "' for " + key;
+                return false;
+            }
+        }
+        if (inputCount != info->inputs) {
+            std::ostringstream expected;
+            expected << opName << " takes " << info->inputs << " inputs";
+            error = where.str() + expected.str();
+            return false;
+        }
+        if (node.op == GraphOp::Fbm) {
+            if (octaves < 0 || octaves > FBM_MAX_OCTAVES) {
+                std::ostringstream range;
+                range << "octaves must be 0 to " << FBM_MAX_OCTAVES;
+                error = where.str() + range.str();
+                return false;
+            }
+            node.tables = makeFbmTables(octaves, persistence, frequency, lacunarity);
+        }
+        if (node.op == GraphOp::Terrace && (node.params[0] < 1.0f || node.params[1] < 1.0f)) {
+            error = where.str() + "terrace needs steps >= 1 and sharpness >= 1";
+            return false;
+        }
+        nodes.push_back(node);
+        names[name] = (int)nodes.size() - 1;
+    }
+    if (nodes.empty()) {
+        error = "recipe has no nodes";
+        return false;
+    }
+
+    // Keep what the output depends on. Inputs always come before their users, so one pass
+    // from the back finds them all.
+    std::vector<bool> live(nodes.size(), false);
+    live.back() = true;
+    for (int i = (int)nodes.size() - 1; i >= 0; i--) {
+        if (!live[i]) continue;
+        const GraphNode& node = nodes[i];
+        for (int input : node.inputs) if (input >= 0) live[input] = true;
+        if (node.warpX >= 0) live[node.warpX] = true;
+        if (node.warpZ >= 0) live[node.warpZ] = true;
+    }
+    std::vector<int> remap(nodes.size(), -1);
+    graph.nodes.clear();
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (!live[i]) continue;
+        GraphNode node = nodes[i];
+        for (int& input : node.inputs) if (input >= 0) input = remap[input];
+        if (node.warpX >= 0) node.warpX = remap[node.warpX];
+        if (node.warpZ >= 0) node.warpZ = remap[node.warpZ];
+        remap[i] = (int)graph.nodes.size();
+        graph.nodes.push_back(node);
+    }
+
+    // Linear scan register allocation: a register frees up after the last node reading it
+    std::vector<int> lastUse(graph.nodes.size());
+    for (size_t i = 0; i < graph.nodes.size(); i++) {
+        lastUse[i] = (int)i;
+        const GraphNode& node = graph.nodes[i];
+        for (int input : node.inputs) if (input >= 0) lastUse[input] = (int)i;
+        if (node.warpX >= 0) lastUse[node.warpX] = (int)i;
+        if (node.warpZ >= 0) lastUse[node.warpZ] = (int)i;
+    }
+    lastUse.back() = (int)graph.nodes.size();  // The output is read after the loop
+    std::vector<int> freeRegisters;
+    graph.registers = 0;
+    graph.octaves = 0;
+    for (size_t i = 0; i < graph.nodes.size(); i++) {
+        GraphNode& node = graph.nodes[i];
+        // Inputs are read before the result is written, so a register freed by this node's own
+        // inputs can't be reused for its result
+        if (freeRegisters.empty()) {
+            node.reg = graph.registers++;
+        }
+        else {
+            node.reg = freeRegisters.back();
+            freeRegisters.pop_back();
+        }
+        for (size_t j = 0; j < i; j++) {
+            if (lastUse[j] == (int)i) freeRegisters.push_back(graph.nodes[j].reg);
+        }
+        if (node.op == GraphOp::Fbm) graph.octaves += node.tables.octaves;
+    }
+    graph.source = text;
+    return true;
+}
+
+bool loadNoiseGraph(const std::string& path, NoiseGraph& graph, std::string& error) {
+    std::ifstream file(path.c_str());
+    if (!file) {
+        error = "can't open " + path;
+        return false;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+    return compileNoiseGraph(text.str(), graph, error);
+}
+
+// Evaluates the graph along one row: row.count vertices, vertex x at world x (x + row.xOffset) -
+// row.halfWidth and world z row.worldZ, with row.scale and row.seed as the terrain's. Writes the
+// output to out, and its derivatives along world x and z to outDx and outDz unless they're null.
+// Rows of vertices spacing world units apart give row.xOffset, halfWidth, worldZ and scale in
+// units of the spacing, like the fBm kernels take them; the derivatives are then per spacing too.
+void evaluateNoiseGraphRow(const NoiseGraph& graph, const FbmRowParams& row, float* out, float* outDx, float* outDz, float spacing = 1.0f) {
+    const bool gradients = outDx != nullptr;
+    const int planes = gradients ? 3 : 1;
+    const int span = NOISE_GRAPH_SPAN;
+    std::vector<float> registers((size_t)graph.registers * 3 * span);
+    float worldX[NOISE_GRAPH_SPAN], worldZ[NOISE_GRAPH_SPAN];
+    float warpedX[NOISE_GRAPH_SPAN], warpedZ[NOISE_GRAPH_SPAN];
+    auto plane = [&](int reg, int p) { return registers.data() + ((size_t)reg * 3 + p) * span; };
+
+    for (int x0 = 0; x0 < row.count; x0 += span) {
+        const int n = std::min(span, row.count - x0);
+        for (int i = 0; i < n; i++) {
+            worldX[i] = ((float)(x0 + i) + row.xOffset) - row.halfWidth;
+            worldZ[i] = row.worldZ;
+        }
+
+        for (const GraphNode& node : graph.nodes) {
+            float* v = plane(node.reg, 0);
+            float* dx = plane(node.reg, 1);
+            float* dz = plane(node.reg, 2);
+            const float *a = nullptr, *adx = nullptr, *adz = nullptr;
+            const float *b = nullptr, *bdx = nullptr, *bdz = nullptr;
+            const float *c = nullptr, *cdx = nullptr, *cdz = nullptr;
+            if (node.inputs[0] >= 0) {
+                int reg = graph.nodes[node.inputs[0]].reg;
+                a = plane(reg, 0); adx = plane(reg, 1); adz = plane(reg, 2);
+            }
+            if (node.inputs[1] >= 0) {
+                int reg = graph.nodes[node.inputs[1]].reg;
+                b = plane(reg, 0); bdx = plane(reg, 1); bdz = plane(reg, 2);
+            }
+            if (node.inputs[2] >= 0) {
+                int reg = graph.nodes[node.inputs[2]].reg;
+                c = plane(reg, 0); cdx = plane(reg, 1); cdz = plane(reg, 2);
+            }
+            // Ops without their own derivative rule leave them at zero
+            if (gradients && node.op == GraphOp::Constant) {
+                std::fill(dx, dx + n, 0.0f);
+                std::fill(dz, dz + n, 0.0f);
+            }
+
+            switch (node.op) {
+            case GraphOp::Constant:
+                std::fill(v, v + n, node.params[0]);
+                break;
+            case GraphOp::Fbm: {
+                FbmRowParams params = row;
+                params.tables = node.tables;
+                params.mode = node.mode;
+                params.seed = row.seed + node.seedOffset;
+                params.firstOctave = 0;
+                params.count = n;
+                const float* sampleX = worldX;
+                const float* sampleZ = worldZ;
+                const float *wx = nullptr, *wz = nullptr;
+                // Warp amounts are in world units
+                const float k = node.warpAmount / spacing;
+                if (node.warpX >= 0 || node.warpZ >= 0) {
+                    wx = node.warpX >= 0 ? plane(graph.nodes[node.warpX].reg, 0) : nullptr;
+                    wz = node.warpZ >= 0 ? plane(graph.nodes[node.warpZ].reg, 0) : nullptr;
+                    for (int i = 0; i < n; i++) {
+                        warpedX[i] = wx ? worldX[i] + k * wx[i] : worldX[i];
+                        warpedZ[i] = wz ? worldZ[i] + k * wz[i] : worldZ[i];
+                    }
+                    sampleX = warpedX;
+                    sampleZ = warpedZ;
+                }
+                FbmPointsFn kernel = getFbmPointsKernel(activeSimdLevel(), node.mode, node.tables.octaves, gradients, node.fractal);
+                kernel(params, sampleX, sampleZ, v, gradients ? dx : nullptr, gradients ? dz : nullptr);
+                if (gradients && (wx || wz)) {
+                    // Chain rule through the warp: d/dx f(x + k wx, z + k wz) =
+                    // fx (1 + k wx_x) + fz k wz_x, and the same along z
+                    const float* wxdx = wx ? plane(graph.nodes[node.warpX].reg, 1) : nullptr;
+                    const float* wxdz = wx ? plane(graph.nodes[node.warpX].reg, 2) : nullptr;
+                    const float* wzdx = wz ? plane(graph.nodes[node.warpZ].reg, 1) : nullptr;
+                    const float* wzdz = wz ? plane(graph.nodes[node.warpZ].reg, 2) : nullptr;
+                    for (int i = 0; i < n; i++) {
+                        float fx = dx[i], fz = dz[i];
+                        dx[i] = fx * (1.0f + (wx ? k * wxdx[i] : 0.0f)) + fz * (wz ? k * wzdx[i] : 0.0f);
+                        dz[i] = fx * (wx ? k * wxdz[i] : 0.0f) + fz * (1.0f + (wz ? k * wzdz[i] : 0.0f));
+                    }
+                }
+                break;
+            }
+            case GraphOp::Add:
+                for (int i = 0; i < n; i++) v[i] = a[i] + b[i];
+                if (gradients) for (int i = 0; i < n; i++) {
+                    dx[i] = adx[i] + bdx[i];
+                    dz[i] = adz[i] + bdz[i];
+                }
+                break;
+            case GraphOp::Subtract:
+                for (int i = 0; i < n; i++) v[i] = a[i] - b[i];
+                if (gradients) for (int i = 0; i < n; i++) {
+                    dx[i] = adx[i] - bdx[i];
+                    dz[i] = adz[i] - bdz[i];
+                }
+                break;
+            case GraphOp::Multiply:
+                // Derivatives first, they need both inputs and v may share a register with neither
+                if (gradients) for (int i = 0; i < n; i++) {
+                    dx[i] = adx[i] * b[i] + a[i] * bdx[i];
+                    dz[i] = adz[i] * b[i] + a[i] * bdz[i];
+                }
+                for (int i = 0; i < n; i++) v[i] = a[i] * b[i];
+                break;
+            case GraphOp::Min:
+            case GraphOp::Max:
+                for (int i = 0; i < n; i++) {
+                    bool pickA = node.op == GraphOp::Min ? a[i] <= b[i] : a[i] >= b[i];
+                    v[i] = pickA ? a[i] : b[i];
+                    if (gradients) {
+                        dx[i] = pickA ? adx[i] : bdx[i];
+                        dz[i] = pickA ? adz[i] : bdz[i];
+                    }
+                }
+                break;
+            case GraphOp::Abs:
+                for (int i = 0; i < n; i++) {
+                    float sign = a[i] < 0.0f ? -1.0f : 1.0f;
+                    v[i] = std::fabs(a[i]);
+                    if (gradients) {
+                        dx[i] = sign * adx[i];
+                        dz[i] = sign * adz[i];
+                    }
+                }
+                break;
+            case GraphOp::Scale:
+                for (int i = 0; i < n; i++) v[i] = a[i] * node.params[0] + node.params[1];
+                if (gradients) for (int i = 0; i < n; i++) {
+                    dx[i] = adx[i] * node.params[0];
+                    dz[i] = adz[i] * node.params[0];
+                }
+                break;
+            case GraphOp::Clamp:
+                for (int i = 0; i < n; i++) {
+                    bool inside = a[i] > node.params[0] && a[i] < node.params[1];
+                    v[i] = std::min(std::max(a[i], node.params[0]), node.params[1]);
+                    if (gradients) {
+                        dx[i] = inside ? adx[i] : 0.0f;
+                        dz[i] = inside ? adz[i] : 0.0f;
+                    }
+                }
+                break;
+            case GraphOp::Lerp:
+            case GraphOp::Blend:
+                for (int i = 0; i < n; i++) {
+                    float t = c[i], tdx = gradients ? cdx[i] : 0.0f, tdz = gradients ? cdz[i] : 0.0f;
+                    if (node.op == GraphOp::Blend) {
+                        // smoothstep(lo, hi, mask)
+                        float range = node.params[1] - node.params[0];
+                        float s = range != 0.0f ? (t - node.params[0]) / range : (t >= node.params[1] ? 1.0f : 0.0f);
+                        bool inside = s > 0.0f && s < 1.0f;
+                        s = std::min(std::max(s, 0.0f), 1.0f);
+                        float slope = inside ? 6.0f * s * (1.0f - s) / range : 0.0f;
+                        t = s * s * (3.0f - 2.0f * s);
+                        tdx *= slope;
+                        tdz *= slope;
+                    }
+                    float difference = b[i] - a[i];
+                    if (gradients) {
+                        dx[i] = adx[i] + (bdx[i] - adx[i]) * t + difference * tdx;
+                        dz[i] = adz[i] + (bdz[i] - adz[i]) * t + difference * tdz;
+                    }
+                    v[i] = a[i] + difference * t;
+                }
+                break;
+            case GraphOp::Terrace:
+                for (int i = 0; i < n; i++) {
+                    // Level k plus f^sharpness of the way to the next, so levels stay joined
+                    float steps = node.params[0], sharpness = node.params[1];
+                    float t = a[i] * steps;
+                    float level = std::floor(t);
+                    float f = t - level;
+                    float slope = sharpness * std::pow(f, sharpness - 1.0f);
+                    if (gradients) {
+                        dx[i] = adx[i] * slope;
+                        dz[i] = adz[i] * slope;
+                    }
+                    v[i] = (level + std::pow(f, sharpness)) / steps;
+                }
+                break;
+            }
+        }
+
+        const int output = graph.nodes.back().reg;
+        float* targets[3] = { out, outDx, outDz };
+        for (int p = 0; p < planes; p++) {
+            std::copy(plane(output, p), plane(output, p) + n, targets[p] + x0);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,956 @@
+// Noise kernels written once against the batch types F (float lanes), I (uint32 lanes) and
+// M (lane mask). No include guard: noise_simd.h includes this file once per instruction set
+// namespace, after defining F, I, M and the operators for that instruction set.
+
+// mod 289 and the permutation polynomial from glm/detail/_noise.hpp
+inline F mod289(F x) {
+    return x - floor(x * F(1.0f / 289.0f)) * F(289.0f);
+}
+
+inline F permute(F x) {
+    return mod289(((x * F(34.0f)) + F(1.0f)) * x);
+}
+
+inline F fract(F x) {
+    return x - floor(x);
+}
+
+// glm::step(edge, x): 0 where x < edge, 1 otherwise
+inline F step(F edge, F x) {
+    return select(lessThan(x, edge), F(0.0f), F(1.0f));
+}
+
+inline F mix(F x, F y, F a) {
+    return x * (F(1.0f) - a) + y * a;
+}
+
+inline F fade(F t) {
+    return (t * t * t) * (t * (t * F(6.0f) - F(15.0f)) + F(10.0f));
+}
+
+// d fade / dt = 30 t^2 (t - 1)^2
+inline F fadeDerivative(F t) {
+    return F(30.0f) * (t * t) * (t * (t - F(2.0f)) + F(1.0f));
+}
+
+// Gradient for one cube corner from its permuted hash, normalized like glm does
+inline void perlin3Gradient(F hash, F& gx, F& gy, F& gz) {
+    gx = hash * F(1.0f / 7.0f);
+    gy = fract(floor(gx) * F(1.0f / 7.0f)) - F(0.5f);
+    gx = fract(gx);
+    gz = F(0.5f) - abs(gx) - abs(gy);
+    F sz = step(gz, F(0.0f));
+    gx = gx - sz * (step(F(0.0f), gx) - F(0.5f));
+    gy = gy - sz * (step(F(0.0f), gy) - F(0.5f));
+
+    F norm = F(1.79284291400159f) - F(0.85373472095314f) * ((gx * gx + gy * gy) + gz * gz);
+    gx = gx * norm;
+    gy = gy * norm;
+    gz = gz * norm;
+}
+
+inline F perlin3Corner(F hash, F fx, F fy, F fz) {
+    F gx, gy, gz;
+    perlin3Gradient(hash, gx, gy, gz);
+    return (gx * fx + gy * fy) + gz * fz;
+}
+
+// Classic 3D Perlin noise, lane for lane the same arithmetic as glm::perlin(vec3)
+inline F perlin3(F px, F py, F pz) {
+    F pi0x = floor(px), pi0y = floor(py), pi0z = floor(pz);
+    F pi1x = mod289(pi0x + F(1.0f)), pi1y = mod289(pi0y + F(1.0f)), pi1z = mod289(pi0z + F(1.0f));
+    F pf0x = fract(px), pf0y = fract(py), pf0z = fract(pz);
+    pi0x = mod289(pi0x);
+    pi0y = mod289(pi0y);
+    pi0z = mod289(pi0z);
+    F pf1x = pf0x - F(1.0f), pf1y = pf0y - F(1.0f), pf1z = pf0z - F(1.0f);
+
+    F px0 = permute(pi0x), px1 = permute(pi1x);
+    F h00 = permute(px0 + pi0y), h10 = permute(px1 + pi0y);
+    F h01 = permute(px0 + pi1y), h11 = permute(px1 + pi1y);
+
+    F n000 = perlin3Corner(permute(h00 + pi0z), pf0x, pf0y, pf0z);
+    F n100 = perlin3Corner(permute(h10 + pi0z), pf1x, pf0y, pf0z);
+    F n010 = perlin3Corner(permute(h01 + pi0z), pf0x, pf1y, pf0z);
+    F n110 = perlin3Corner(permute(h11 + pi0z), pf1x, pf1y, pf0z);
+    F n001 = perlin3Corner(permute(h00 + pi1z), pf0x, pf0y, pf1z);
+    F n101 = perlin3Corner(permute(h10 + pi1z), pf1x, pf0y, pf1z);
+    F n011 = perlin3Corner(permute(h01 + pi1z), pf0x, pf1y, pf1z);
+    F n111 = perlin3Corner(permute(h11 + pi1z), pf1x, pf1y, pf1z);
+
+    F fadeX = fade(pf0x), fadeY = fade(pf0y), fadeZ = fade(pf0z);
+    F nz00 = mix(n000, n001, fadeZ);
+    F nz10 = mix(n100, n101, fadeZ);
+    F nz01 = mix(n010, n011, fadeZ);
+    F nz11 = mix(n110, n111, fadeZ);
+    F ny0 = mix(nz00, nz01, fadeY);
+    F ny1 = mix(nz10, nz11, fadeY);
+    return F(2.2f) * mix(ny0, ny1, fadeX);
+}
+
+// perlin3 together with its analytic derivatives along x and z (y carries the seed and is
+// never differentiated). The value is the same arithmetic as perlin3, bit for bit.
+inline F perlin3Grad(F px, F py, F pz, F& dx, F& dz) {
+    F pi0x = floor(px), pi0y = floor(py), pi0z = floor(pz);
+    F pi1x = mod289(pi0x + F(1.0f)), pi1y = mod289(pi0y + F(1.0f)), pi1z = mod289(pi0z + F(1.0f));
+    F pf0x = fract(px), pf0y = fract(py), pf0z = fract(pz);
+    pi0x = mod289(pi0x);
+    pi0y = mod289(pi0y);
+    pi0z = mod289(pi0z);
+    F pf1x = pf0x - F(1.0f), pf1y = pf0y - F(1.0f), pf1z = pf0z - F(1.0f);
+
+    F px0 = permute(pi0x), px1 = permute(pi1x);
+    F h00 = permute(px0 + pi0y), h10 = permute(px1 + pi0y);
+    F h01 = permute(px0 + pi1y), h11 = permute(px1 + pi1y);
+
+    // Each corner's value is its gradient dotted with the offset, so the gradient is also the
+    // corner's derivative
+    F gx[8], gy[8], gz[8];
+    perlin3Gradient(permute(h00 + pi0z), gx[0], gy[0], gz[0]);
+    perlin3Gradient(permute(h10 + pi0z), gx[1], gy[1], gz[1]);
+    perlin3Gradient(permute(h01 + pi0z), gx[2], gy[2], gz[2]);
+    perlin3Gradient(permute(h11 + pi0z), gx[3], gy[3], gz[3]);
+    perlin3Gradient(permute(h00 + pi1z), gx[4], gy[4], gz[4]);
+    perlin3Gradient(permute(h10 + pi1z), gx[5], gy[5], gz[5]);
+    perlin3Gradient(permute(h01 + pi1z), gx[6], gy[6], gz[6]);
+    perlin3Gradient(permute(h11 + pi1z), gx[7], gy[7], gz[7]);
+    F n000 = (gx[0] * pf0x + gy[0] * pf0y) + gz[0] * pf0z;
+    F n100 = (gx[1] * pf1x + gy[1] * pf0y) + gz[1] * pf0z;
+    F n010 = (gx[2] * pf0x + gy[2] * pf1y) + gz[2] * pf0z;
+    F n110 = (gx[3] * pf1x + gy[3] * pf1y) + gz[3] * pf0z;
+    F n001 = (gx[4] * pf0x + gy[4] * pf0y) + gz[4] * pf1z;
+    F n101 = (gx[5] * pf1x + gy[5] * pf0y) + gz[5] * pf1z;
+    F n011 = (gx[6] * pf0x + gy[6] * pf1y) + gz[6] * pf1z;
+    F n111 = (gx[7] * pf1x + gy[7] * pf1y) + gz[7] * pf1z;
+
+    F fadeX = fade(pf0x), fadeY = fade(pf0y), fadeZ = fade(pf0z);
+    F nz00 = mix(n000, n001, fadeZ);
+    F nz10 = mix(n100, n101, fadeZ);
+    F nz01 = mix(n010, n011, fadeZ);
+    F nz11 = mix(n110, n111, fadeZ);
+    F ny0 = mix(nz00, nz01, fadeY);
+    F ny1 = mix(nz10, nz11, fadeY);
+
+    // d mix(a, b, t) = mix(da, db, t) + (b - a) dt, through the same three levels
+    F dFadeX = fadeDerivative(pf0x), dFadeZ = fadeDerivative(pf0z);
+    F dxy0 = mix(mix(gx[0], gx[4], fadeZ), mix(gx[2], gx[6], fadeZ), fadeY);
+    F dxy1 = mix(mix(gx[1], gx[5], fadeZ), mix(gx[3], gx[7], fadeZ), fadeY);
+    dx = F(2.2f) * (mix(dxy0, dxy1, fadeX) + (ny1 - ny0) * dFadeX);
+    F dz00 = mix(gz[0], gz[4], fadeZ) + (n001 - n000) * dFadeZ;
+    F dz10 = mix(gz[1], gz[5], fadeZ) + (n101 - n100) * dFadeZ;
+    F dz01 = mix(gz[2], gz[6], fadeZ) + (n011 - n010) * dFadeZ;
+    F dz11 = mix(gz[3], gz[7], fadeZ) + (n111 - n110) * dFadeZ;
+    dz = F(2.2f) * mix(mix(dz00, dz01, fadeY), mix(dz10, dz11, fadeY), fadeX);
+    return F(2.2f) * mix(ny0, ny1, fadeX);
+}
+
+// Lattice hash for the seeded 2D noise, keyed per seed/octave instead of a permutation table
+// so it stays pure arithmetic in every lane
+inline I hash2(I ix, I iz, I key) {
+    I h = key ^ (ix * I(0x27D4EB2Du)) ^ (iz * I(0x165667B1u));
+    h = (h ^ (h >> 15)) * I(0x2C1B3C6Du);
+    h = (h ^ (h >> 12)) * I(0x297A2D39u);
+    return h ^ (h >> 15);
+}
+
+// One of 8 gradient directions picked by the low hash bits, dotted with (x, z)
+inline F grad2(I h, F x, F z) {
+    M low = bitClear(h, 4u);
+    F u = select(low, x, z);
+    F v = select(low, z, x);
+    return select(bitClear(h, 1u), u, F(0.0f) - u) + select(bitClear(h, 2u), v * F(2.0f), v * F(-2.0f));
+}
+
+// The (x, z) direction grad2 dots with
+inline void grad2Vector(I h, F& gx, F& gz) {
+    M low = bitClear(h, 4u);
+    F a = select(bitClear(h, 1u), F(1.0f), F(-1.0f));
+    F b = select(bitClear(h, 2u), F(2.0f), F(-2.0f));
+    gx = select(low, a, b);
+    gz = select(low, b, a);
+}
+
+// 2D gradient noise with a seeded lattice, 4 corners per sample, roughly [-1, 1]
+inline F perlin2(F px, F pz, I key) {
+    F fx = floor(px), fz = floor(pz);
+    I ix = toInt(fx), iz = toInt(fz);
+    I ix1 = ix + I(1u), iz1 = iz + I(1u);
+    F tx = px - fx, tz = pz - fz;
+    F tx1 = tx - F(1.0f), tz1 = tz - F(1.0f);
+
+    F n00 = grad2(hash2(ix, iz, key), tx, tz);
+    F n10 = grad2(hash2(ix1, iz, key), tx1, tz);
+    F n01 = grad2(hash2(ix, iz1, key), tx, tz1);
+    F n11 = grad2(hash2(ix1, iz1, key), tx1, tz1);
+
+    F u = fade(tx), v = fade(tz);
+    return F(0.507f) * mix(mix(n00, n10, u), mix(n01, n11, u), v);
+}
+
+// perlin2 together with its analytic derivatives along x and z, the value bit for bit the same
+inline F perlin2Grad(F px, F pz, I key, F& dx, F& dz) {
+    F fx = floor(px), fz = floor(pz);
+    I ix = toInt(fx), iz = toInt(fz);
+    I ix1 = ix + I(1u), iz1 = iz + I(1u);
+    F tx = px - fx, tz = pz - fz;
+    F tx1 = tx - F(1.0f), tz1 = tz - F(1.0f);
+
+    I h00 = hash2(ix, iz, key), h10 = hash2(ix1, iz, key);
+    I h01 = hash2(ix, iz1, key), h11 = hash2(ix1, iz1, key);
+    F n00 = grad2(h00, tx, tz);
+    F n10 = grad2(h10, tx1, tz);
+    F n01 = grad2(h01, tx, tz1);
+    F n11 = grad2(h11, tx1, tz1);
+    F gx00, gz00, gx10, gz10, gx01, gz01, gx11, gz11;
+    grad2Vector(h00, gx00, gz00);
+    grad2Vector(h10, gx10, gz10);
+    grad2Vector(h01, gx01, gz01);
+    grad2Vector(h11, gx11, gz11);
+
+    F u = fade(tx), v = fade(tz);
+    F du = fadeDerivative(tx), dv = fadeDerivative(tz);
+    F nx0 = mix(n00, n10, u), nx1 = mix(n01, n11, u);
+    dx = F(0.507f) * mix(mix(gx00, gx10, u) + (n10 - n00) * du, mix(gx01, gx11, u) + (n11 - n01) * du, v);
+    dz = F(0.507f) * (mix(mix(gz00, gz10, u), mix(gz01, gz11, u), v) + (nx1 - nx0) * dv);
+    return F(0.507f) * mix(nx0, nx1, v);
+}
+
+inline F max0(F a) {
+    return select(lessThan(a, F(0.0f)), F(0.0f), a);
+}
+
+// 3D simplex noise with its derivatives along x and z, lane for lane the same arithmetic as
+// glm::simplex(vec3) for the value. Each corner adds 42 m^4 (g . d) with m = max(0.6 - |d|^2, 0),
+// so its derivative is 42 (m^4 g - 8 m^3 (g . d) d).
+inline F simplex3Grad(F px, F py, F pz, F& dx, F& dz) {
+    const float cx = 1.0f / 6.0f, cy = 1.0f / 3.0f;
+
+    // First corner
+    F s = (px * F(cy) + py * F(cy)) + pz * F(cy);
+    F ix = floor(px + s), iy = floor(py + s), iz = floor(pz + s);
+    F t = (ix * F(cx) + iy * F(cx)) + iz * F(cx);
+    F x0[3] = { (px - ix) + t, (py - iy) + t, (pz - iz) + t };
+
+    // Other corners: which axes the path through the simplex steps along first and second.
+    // g and l are 0 or 1, so min and max are a product and a sum.
+    F gx = step(x0[1], x0[0]), gy = step(x0[2], x0[1]), gz = step(x0[0], x0[2]);
+    F lx = F(1.0f) - gx, ly = F(1.0f) - gy, lz = F(1.0f) - gz;
+    F i1[3] = { gx * lz, gy * lx, gz * ly };
+    F i2[3] = { (gx + lz) - gx * lz, (gy + lx) - gy * lx, (gz + ly) - gz * ly };
+
+    F x[4][3];
+    for (int a = 0; a < 3; a++) {
+        x[0][a] = x0[a];
+        x[1][a] = (x0[a] - i1[a]) + F(cx);
+        x[2][a] = (x0[a] - i2[a]) + F(cy);
+        x[3][a] = x0[a] - F(0.5f);
+    }
+
+    ix = mod289(ix);
+    iy = mod289(iy);
+    iz = mod289(iz);
+    F offset[4][3] = {
+        { F(0.0f), F(0.0f), F(0.0f) },
+        { i1[0], i1[1], i1[2] },
+        { i2[0], i2[1], i2[2] },
+        { F(1.0f), F(1.0f), F(1.0f) }
+    };
+
+    const float n = 0.142857142857f;   // 1 / 7
+    const float nsx = n * 2.0f - 0.0f, nsy = n * 0.5f - 1.0f, nsz = n * 1.0f - 0.0f;
+    F contribution[4];
+    dx = F(0.0f);
+    dz = F(0.0f);
+    for (int k = 0; k < 4; k++) {
+        F p = permute(permute(permute(iz + offset[k][2]) + iy + offset[k][1]) + ix + offset[k][0]);
+
+        // Gradients: 7x7 points over a square, mapped onto an octahedron
+        F j = p - F(49.0f) * floor((p * F(nsz)) * F(nsz));
+        F xg = floor(j * F(nsz));
+        F yg = floor(j - F(7.0f) * xg);
+        F gxk = xg * F(nsx) + F(nsy);
+        F gyk = yg * F(nsx) + F(nsy);
+        F gzk = (F(1.0f) - abs(gxk)) - abs(gyk);
+        F sh = F(0.0f) - step(gzk, F(0.0f));
+        gxk = gxk + (floor(gxk) * F(2.0f) + F(1.0f)) * sh;
+        gyk = gyk + (floor(gyk) * F(2.0f) + F(1.0f)) * sh;
+        F norm = F(1.79284291400159f) - F(0.85373472095314f) * ((gxk * gxk + gyk * gyk) + gzk * gzk);
+        gxk = gxk * norm;
+        gyk = gyk * norm;
+        gzk = gzk * norm;
+
+        F m = max0(F(0.6f) - ((x[k][0] * x[k][0] + x[k][1] * x[k][1]) + x[k][2] * x[k][2]));
+        F m2 = m * m;
+        F m4 = m2 * m2;
+        F dot = (gxk * x[k][0] + gyk * x[k][1]) + gzk * x[k][2];
+        contribution[k] = m4 * dot;
+        F slope = F(8.0f) * (m2 * m) * dot;
+        dx = dx + (m4 * gxk - slope * x[k][0]);
+        dz = dz + (m4 * gzk - slope * x[k][2]);
+    }
+    dx = F(42.0f) * dx;
+    dz = F(42.0f) * dz;
+    // Summed pairwise like glm's vec4 dot
+    return F(42.0f) * ((contribution[0] + contribution[1]) + (contribution[2] + contribution[3]));
+}
+
+inline F simplex3(F px, F py, F pz) {
+    F dx, dz;
+    return simplex3Grad(px, py, pz, dx, dz);
+}
+
+// One of 16 directions of length sqrt(5) picked by the low hash bits: grad2's 8, then the axes
+// and diagonals in between
+inline void gradient16(I h, F& gx, F& gz) {
+    F ax, az;
+    grad2Vector(h, ax, az);
+    F sx = select(bitClear(h, 1u), F(1.0f), F(-1.0f));
+    F sz = select(bitClear(h, 2u), F(1.0f), F(-1.0f));
+    M axis = bitClear(h, 4u);
+    F bx = select(axis, select(bitClear(h, 2u), sx * F(2.23606798f), F(0.0f)), sx * F(1.58113883f));
+    F bz = select(axis, select(bitClear(h, 2u), F(0.0f), sx * F(2.23606798f)), sz * F(1.58113883f));
+    M first = bitClear(h, 8u);
+    gx = select(first, ax, bx);
+    gz = select(first, az, bz);
+}
+
+// One simplex corner: a^4 (g . d) with a = max(0.5 - |d|^2, 0), accumulated with its derivative
+inline void openSimplex2Corner(I h, F cx, F cz, F& value, F& dx, F& dz) {
+    F gx, gz;
+    gradient16(h, gx, gz);
+    F a = max0(F(0.5f) - (cx * cx + cz * cz));
+    F a2 = a * a;
+    F a4 = a2 * a2;
+    F dot = gx * cx + gz * cz;
+    value = value + a4 * dot;
+    F slope = F(8.0f) * (a2 * a) * dot;
+    dx = dx + (a4 * gx - slope * cx);
+    dz = dz + (a4 * gz - slope * cz);
+}
+
+// 2D noise on the OpenSimplex2 lattice: skewed simplex cells, the two corners every point sees
+// plus the one on its side of the diagonal, radius^2 0.5 kernels. The lattice hash and 16
+// gradient directions are this file's own so every lane stays 32-bit arithmetic.
+inline F openSimplex2Grad(F px, F pz, I key, F& dx, F& dz) {
+    const float skew = 0.366025403784439f;      // (sqrt(3) - 1) / 2
+    const float unskew = -0.211324865405187f;   // (1 / sqrt(3) - 1) / 2
+    F s = (px + pz) * F(skew);
+    F xsb = floor(px + s), zsb = floor(pz + s);
+    F xi = (px + s) - xsb, zi = (pz + s) - zsb;
+    F t = (xi + zi) * F(unskew);
+    F dx0 = xi + t, dz0 = zi + t;
+    I ix = toInt(xsb), iz = toInt(zsb);
+
+    F value(0.0f);
+    dx = F(0.0f);
+    dz = F(0.0f);
+    openSimplex2Corner(hash2(ix, iz, key), dx0, dz0, value, dx, dz);
+    openSimplex2Corner(hash2(ix + I(1u), iz + I(1u), key), dx0 - F(1.0f + 2.0f * unskew), dz0 - F(1.0f + 2.0f * unskew), value, dx, dz);
+
+    // Third corner is (0, 1) above the cell's diagonal and (1, 0) below it
+    M upper = lessThan(dx0, dz0);
+    F ox = select(upper, F(0.0f), F(1.0f));
+    F oz = F(1.0f) - ox;
+    openSimplex2Corner(hash2(toInt(xsb + ox), toInt(zsb + oz), key), (dx0 - ox) - F(unskew), (dz0 - oz) - F(unskew), value, dx, dz);
+
+    const float toUnit = 40.0f;
+    dx = F(toUnit) * dx;
+    dz = F(toUnit) * dz;
+    return F(toUnit) * value;
+}
+
+inline F openSimplex2(F px, F pz, I key) {
+    F dx, dz;
+    return openSimplex2Grad(px, pz, key, dx, dz);
+}
+
+// Lattice value in [-1, 1] from the top 24 bits of the hash
+inline F latticeValue(I h) {
+    return toFloat(h >> 8) * F(2.0f / 16777215.0f) - F(1.0f);
+}
+
+// Hashed value noise: random heights at the lattice points, blended with the quintic fade.
+// Cheapest per corner, but blobbier than gradient noise.
+inline F value2Grad(F px, F pz, I key, F& dx, F& dz) {
+    F fx = floor(px), fz = floor(pz);
+    I ix = toInt(fx), iz = toInt(fz);
+    I ix1 = ix + I(1u), iz1 = iz + I(1u);
+    F tx = px - fx, tz = pz - fz;
+
+    F v00 = latticeValue(hash2(ix, iz, key));
+    F v10 = latticeValue(hash2(ix1, iz, key));
+    F v01 = latticeValue(hash2(ix, iz1, key));
+    F v11 = latticeValue(hash2(ix1, iz1, key));
+
+    F u = fade(tx), v = fade(tz);
+    F nx0 = mix(v00, v10, u), nx1 = mix(v01, v11, u);
+    dx = mix(v10 - v00, v11 - v01, v) * fadeDerivative(tx);
+    dz = (nx1 - nx0) * fadeDerivative(tz);
+    return mix(nx0, nx1, v);
+}
+
+inline F value2(F px, F pz, I key) {
+    F dx, dz;
+    return value2Grad(px, pz, key, dx, dz);
+}
+
+// Per-octave samplers: setup() once per row and octave, sample() once per batch with the
+// vertex x already divided by scale. sampleGrad() also gives the derivatives along the sample
+// coordinates, which are world x and z / scale times the octave's frequency. samplePoint()
+// and samplePointGrad() take z per lane too, also divided by scale, for scattered positions.
+struct Perlin3DOctave {
+    F freq, sampleY, sampleZ;
+    void setup(const FbmRowParams& p, int octave) {
+        float currentFreq = p.tables.frequency[octave];
+        freq = F(currentFreq);
+        // Incorporate seed for consistent randomness
+        sampleY = F(p.seed * 0.5f * currentFreq);
+        sampleZ = F((p.worldZ / p.scale) * currentFreq);
+    }
+    F sample(F x) const { return perlin3(x * freq, sampleY, sampleZ); }
+    F sampleGrad(F x, F& dx, F& dz) const { return perlin3Grad(x * freq, sampleY, sampleZ, dx, dz); }
+    F samplePoint(F x, F z) const { return perlin3(x * freq, sampleY, z * freq); }
+    F samplePointGrad(F x, F z, F& dx, F& dz) const { return perlin3Grad(x * freq, sampleY, z * freq, dx, dz); }
+};
+
+struct Seeded2DOctave {
+    F freq, sampleZ;
+    I key;
+    void setup(const FbmRowParams& p, int octave) {
+        float currentFreq = p.tables.frequency[octave];
+        freq = F(currentFreq);
+        sampleZ = F((p.worldZ / p.scale) * currentFreq);
+        key = I(seedKeyForOctave(p.seed, p.firstOctave + octave));
+    }
+    F sample(F x) const { return perlin2(x * freq, sampleZ, key); }
+    F sampleGrad(F x, F& dx, F& dz) const { return perlin2Grad(x * freq, sampleZ, key, dx, dz); }
+    F samplePoint(F x, F z) const { return perlin2(x * freq, z * freq, key); }
+    F samplePointGrad(F x, F z, F& dx, F& dz) const { return perlin2Grad(x * freq, z * freq, key, dx, dz); }
+};
+
+struct Simplex3DOctave {
+    F freq, sampleY, sampleZ;
+    void setup(const FbmRowParams& p, int octave) {
+        float currentFreq = p.tables.frequency[octave];
+        freq = F(currentFreq);
+        sampleY = F(p.seed * 0.5f * currentFreq);
+        sampleZ = F((p.worldZ / p.scale) * currentFreq);
+    }
+    F sample(F x) const { return simplex3(x * freq, sampleY, sampleZ); }
+    F sampleGrad(F x, F& dx, F& dz) const { return simplex3Grad(x * freq, sampleY, sampleZ, dx, dz); }
+    F samplePoint(F x, F z) const { return simplex3(x * freq, sampleY, z * freq); }
+    F samplePointGrad(F x, F z, F& dx, F& dz) const { return simplex3Grad(x * freq, sampleY, z * freq, dx, dz); }
+};
+
+struct OpenSimplex2Octave {
+    F freq, sampleZ;
+    I key;
+    void setup(const FbmRowParams& p, int octave) {
+        float currentFreq = p.tables.frequency[octave];
+        freq = F(currentFreq);
+        sampleZ = F((p.worldZ / p.scale) * currentFreq);
+        key = I(seedKeyForOctave(p.seed, p.firstOctave + octave));
+    }
+    F sample(F x) const { return openSimplex2(x * freq, sampleZ, key); }
+    F sampleGrad(F x, F& dx, F& dz) const { return openSimplex2Grad(x * freq, sampleZ, key, dx, dz); }
+    F samplePoint(F x, F z) const { return openSimplex2(x * freq, z * freq, key); }
+    F samplePointGrad(F x, F z, F& dx, F& dz) const { return openSimplex2Grad(x * freq, z * freq, key, dx, dz); }
+};
+
+struct Value2DOctave {
+    F freq, sampleZ;
+    I key;
+    void setup(const FbmRowParams& p, int octave) {
+        float currentFreq = p.tables.frequency[octave];
+        freq = F(currentFreq);
+        sampleZ = F((p.worldZ / p.scale) * currentFreq);
+        key = I(seedKeyForOctave(p.seed, p.firstOctave + octave));
+    }
+    F sample(F x) const { return value2(x * freq, sampleZ, key); }
+    F sampleGrad(F x, F& dx, F& dz) const { return value2Grad(x * freq, sampleZ, key, dx, dz); }
+    F samplePoint(F x, F z) const { return value2(x * freq, z * freq, key); }
+    F samplePointGrad(F x, F z, F& dx, F& dz) const { return value2Grad(x * freq, z * freq, key, dx, dz); }
+};
+
+// Octave chain unrolled at compile time: sum += sample_o * amplitude_o for o = O..Octaves-1
+template<int O, int Octaves, class Octave>
+struct FbmOctaves {
+    static F accumulate(F sum, F x, const Octave* octaves, const F* amplitudes) {
+        return FbmOctaves<O + 1, Octaves, Octave>::accumulate(sum + octaves[O].sample(x) * amplitudes[O], x, octaves, amplitudes);
+    }
+};
+
+template<int Octaves, class Octave>
+struct FbmOctaves<Octaves, Octaves, Octave> {
+    static F accumulate(F sum, F, const Octave*, const F*) { return sum; }
+};
+
+// Same chain with derivatives: slopes_o is amplitude_o * frequency_o / scale, which turns an
+// octave's derivative along its sample coordinates into one along world x and z
+template<int O, int Octaves, class Octave>
+struct FbmOctavesGrad {
+    static F accumulate(F sum, F& dxSum, F& dzSum, F x, const Octave* octaves, const F* amplitudes, const F* slopes) {
+        F dx, dz;
+        F value = octaves[O].sampleGrad(x, dx, dz);
+        dxSum = dxSum + dx * slopes[O];
+        dzSum = dzSum + dz * slopes[O];
+        return FbmOctavesGrad<O + 1, Octaves, Octave>::accumulate(sum + value * amplitudes[O], dxSum, dzSum, x, octaves, amplitudes, slopes);
+    }
+};
+
+template<int Octaves, class Octave>
+struct FbmOctavesGrad<Octaves, Octaves, Octave> {
+    static F accumulate(F sum, F&, F&, F, const Octave*, const F*, const F*) { return sum; }
+};
+
+// Stores the batch of row values starting at vertex x, the last partial batch of the row
+// through a padded copy
+inline void storeRowBatch(F value, float* out, int x, int n) {
+    if (x + F::Size <= n) {
+        value.store(out + x);
+    }
+    else {
+        float tail[F::Size];
+        value.store(tail);
+        std::memcpy(out + x, tail, (n - x) * sizeof(float));
+    }
+}
+
+// Normalized fBm for one row of vertices with a fixed octave count
+template<int Octaves, class Octave>
+void fbmRowN(const FbmRowParams& p, float* out) {
+    Octave octaves[Octaves];
+    F amplitudes[Octaves];
+    for (int o = 0; o < Octaves; o++) {
+        octaves[o].setup(p, o);
+        amplitudes[o] = F(p.tables.amplitude[o]);
+    }
+    F scale(p.scale);
+    F xOffset(p.xOffset);
+    F halfWidth(p.halfWidth);
+    F maxValue(p.tables.maxValue);
+
+    const int n = p.count;
+    for (int x = 0; x < n; x += F::Size) {
+        F worldX = (F::ramp((float)x) + xOffset) - halfWidth;
+        F sum = FbmOctaves<0, Octaves, Octave>::accumulate(F(0.0f), worldX / scale, octaves, amplitudes);
+        F heightValue = sum / maxValue;
+        storeRowBatch(heightValue, out, x, n);
+    }
+}
+
+// fbmRowN plus the derivatives of the normalized fBm along world x and z, in the same pass.
+// out gets the same values as fbmRowN.
+template<int Octaves, class Octave>
+void fbmRowGradN(const FbmRowParams& p, float* out, float* outDx, float* outDz) {
+    Octave octaves[Octaves];
+    F amplitudes[Octaves];
+    F slopes[Octaves];
+    for (int o = 0; o < Octaves; o++) {
+        octaves[o].setup(p, o);
+        amplitudes[o] = F(p.tables.amplitude[o]);
+        slopes[o] = F(p.tables.amplitude[o] * p.tables.frequency[o] / p.scale);
+    }
+    F scale(p.scale);
+    F xOffset(p.xOffset);
+    F halfWidth(p.halfWidth);
+    F maxValue(p.tables.maxValue);
+
+    const int n = p.count;
+    for (int x = 0; x < n; x += F::Size) {
+        F worldX = (F::ramp((float)x) + xOffset) - halfWidth;
+        F dx(0.0f), dz(0.0f);
+        F sum = FbmOctavesGrad<0, Octaves, Octave>::accumulate(F(0.0f), dx, dz, worldX / scale, octaves, amplitudes, slopes);
+        storeRowBatch(sum / maxValue, out, x, n);
+        storeRowBatch(dx / maxValue, outDx, x, n);
+        storeRowBatch(dz / maxValue, outDz, x, n);
+    }
+}
+
+// Normalized fBm at count scattered world positions (x and z per point) rather than along a row;
+// p.worldZ, xOffset and halfWidth are unused. With Gradients the derivatives along world x and
+// z go to outDx and outDz, otherwise those may be null. A point at a row's vertex position gets
+// the same value as the row kernel gives it.
+template<int Octaves, class Octave, bool Gradients>
+void fbmPointsN(const FbmRowParams& p, const float* worldX, const float* worldZ, float* out, float* outDx, float* outDz) {
+    Octave octaves[Octaves];
+    F amplitudes[Octaves];
+    F slopes[Octaves];
+    for (int o = 0; o < Octaves; o++) {
+        octaves[o].setup(p, o);
+        amplitudes[o] = F(p.tables.amplitude[o]);
+        slopes[o] = F(p.tables.amplitude[o] * p.tables.frequency[o] / p.scale);
+    }
+    F scale(p.scale);
+    F maxValue(p.tables.maxValue);
+
+    const int n = p.count;
+    for (int i = 0; i < n; i += F::Size) {
+        F x, z;
+        if (i + F::Size <= n) {
+            x = F::load(worldX + i) / scale;
+            z = F::load(worldZ + i) / scale;
+        }
+        else {
+            float tailX[F::Size] = {}, tailZ[F::Size] = {};
+            std::memcpy(tailX, worldX + i, (n - i) * sizeof(float));
+            std::memcpy(tailZ, worldZ + i, (n - i) * sizeof(float));
+            x = F::load(tailX) / scale;
+            z = F::load(tailZ) / scale;
+        }
+
+        // The octave count is a constant, the compiler unrolls this like the row chains
+        F sum(0.0f), dx(0.0f), dz(0.0f);
+        for (int o = 0; o < Octaves; o++) {
+            if (Gradients) {
+                F octaveDx, octaveDz;
+                sum = sum + octaves[o].samplePointGrad(x, z, octaveDx, octaveDz) * amplitudes[o];
+                dx = dx + octaveDx * slopes[o];
+                dz = dz + octaveDz * slopes[o];
+            }
+            else {
+                sum = sum + octaves[o].samplePoint(x, z) * amplitudes[o];
+            }
+        }
+        storeRowBatch(sum / maxValue, out, i, n);
+        if (Gradients) {
+            storeRowBatch(dx / maxValue, outDx, i, n);
+            storeRowBatch(dz / maxValue, outDz, i, n);
+        }
+    }
+}
+
+// Multifractals: every octave's noise n (range about [-1, 1]) with its derivatives along world x
+// and z, folded in by add() in octave order, and the normalized result with its derivatives from
+// finish(). Each keeps its per-octave weight in registers, so the octaves cost about what fBm's do.
+
+// Billow: sum of amplitude * (2|n| - 1), rounded hills between creased valleys
+struct BillowFractal {
+    F sum, dx, dz;
+    BillowFractal() : sum(0.0f), dx(0.0f), dz(0.0f) {}
+    template<bool Gradients>
+    void add(F n, F ndx, F ndz, F amplitude) {
+        sum = sum + (abs(n) * F(2.0f) - F(1.0f)) * amplitude;
+        if (Gradients) {
+            F slope = select(lessThan(n, F(0.0f)), F(-2.0f), F(2.0f)) * amplitude;
+            dx = dx + ndx * slope;
+            dz = dz + ndz * slope;
+        }
+    }
+    F finish(F maxValue, F& outDx, F& outDz) const {
+        outDx = dx / maxValue;
+        outDz = dz / maxValue;
+        return sum / maxValue;
+    }
+};
+
+// Musgrave's ridged multifractal with offset 1 and gain 2: signal = (1 - |n|)^2 * weight, and the
+// next octave's weight is clamp(signal * gain, 0, 1), so detail only builds up along the ridges.
+// Signals are within [0, 1], the sum maps to [-1, 1].
+struct RidgedFractal {
+    F sum, dx, dz, weight, weightDx, weightDz;
+    RidgedFractal() : sum(0.0f), dx(0.0f), dz(0.0f), weight(1.0f), weightDx(0.0f), weightDz(0.0f) {}
+    template<bool Gradients>
+    void add(F n, F ndx, F ndz, F amplitude) {
+        F ridge = F(1.0f) - abs(n);
+        F signal = ridge * ridge * weight;
+        sum = sum + signal * amplitude;
+        F nextWeight = signal * F(2.0f);
+        M below = lessThan(nextWeight, F(1.0f)); // Signals are never negative, only the top clamps
+        if (Gradients) {
+            // d(1 - |n|) = -sign(n) dn
+            M negative = lessThan(n, F(0.0f));
+            F ridgeDx = select(negative, ndx, F(0.0f) - ndx);
+            F ridgeDz = select(negative, ndz, F(0.0f) - ndz);
+            F signalDx = F(2.0f) * ridge * ridgeDx * weight + ridge * ridge * weightDx;
+            F signalDz = F(2.0f) * ridge * ridgeDz * weight + ridge * ridge * weightDz;
+            dx = dx + signalDx * amplitude;
+            dz = dz + signalDz * amplitude;
+            weightDx = select(below, signalDx * F(2.0f), F(0.0f));
+            weightDz = select(below, signalDz * F(2.0f), F(0.0f));
+        }
+        weight = select(below, nextWeight, F(1.0f));
+    }
+    F finish(F maxValue, F& outDx, F& outDz) const {
+        outDx = dx * F(2.0f) / maxValue;
+        outDz = dz * F(2.0f) / maxValue;
+        return sum * F(2.0f) / maxValue - F(1.0f);
+    }
+};
+
+// Musgrave's hybrid multifractal with offset 1: signal = (n + 1) * amplitude is added times a
+// weight, the product of the signals so far capped at 1, so valleys stay smooth while peaks get
+// rough. The sum is within [0, 2 * maxValue] and maps to [-1, 1].
+struct HybridFractal {
+    F sum, dx, dz, weight, weightDx, weightDz;
+    HybridFractal() : sum(0.0f), dx(0.0f), dz(0.0f), weight(1.0f), weightDx(0.0f), weightDz(0.0f) {}
+    template<bool Gradients>
+    void add(F n, F ndx, F ndz, F amplitude) {
+        F signal = (n + F(1.0f)) * amplitude;
+        sum = sum + weight * signal;
+        F nextWeight = weight * signal;
+        M below = lessThan(nextWeight, F(1.0f));
+        if (Gradients) {
+            F signalDx = ndx * amplitude;
+            F signalDz = ndz * amplitude;
+            F productDx = weightDx * signal + weight * signalDx;
+            F productDz = weightDz * signal + weight * signalDz;
+            dx = dx + productDx;
+            dz = dz + productDz;
+            weightDx = select(below, productDx, F(0.0f));
+            weightDz = select(below, productDz, F(0.0f));
+        }
+        weight = select(below, nextWeight, F(1.0f));
+    }
+    F finish(F maxValue, F& outDx, F& outDz) const {
+        outDx = dx / maxValue;
+        outDz = dz / maxValue;
+        return sum / maxValue - F(1.0f);
+    }
+};
+
+// Row of a multifractal with a fixed octave count, derivatives only with Gradients
+template<int Octaves, class Octave, class Fractal, bool Gradients>
+void fractalRow(const FbmRowParams& p, float* out, float* outDx, float* outDz) {
+    Octave octaves[Octaves];
+    F amplitudes[Octaves];
+    F rates[Octaves];   // Octave sample coordinates per world unit
+    for (int o = 0; o < Octaves; o++) {
+        octaves[o].setup(p, o);
+        amplitudes[o] = F(p.tables.amplitude[o]);
+        rates[o] = F(p.tables.frequency[o] / p.scale);
+    }
+    F scale(p.scale);
+    F xOffset(p.xOffset);
+    F halfWidth(p.halfWidth);
+    F maxValue(p.tables.maxValue);
+
+    const int n = p.count;
+    for (int x = 0; x < n; x += F::Size) {
+        F sampleX = ((F::ramp((float)x) + xOffset) - halfWidth) / scale;
+        Fractal fractal;
+        for (int o = 0; o < Octaves; o++) {
+            if (Gradients) {
+                F octaveDx, octaveDz;
+                F value = octaves[o].sampleGrad(sampleX, octaveDx, octaveDz);
+                fractal.template add<true>(value, octaveDx * rates[o], octaveDz * rates[o], amplitudes[o]);
+            }
+            else {
+                fractal.template add<false>(octaves[o].sample(sampleX), F(0.0f), F(0.0f), amplitudes[o]);
+            }
+        }
+        F dx, dz;
+        storeRowBatch(fractal.finish(maxValue, dx, dz), out, x, n);
+        if (Gradients) {
+            storeRowBatch(dx, outDx, x, n);
+            storeRowBatch(dz, outDz, x, n);
+        }
+    }
+}
+
+template<int Octaves, class Octave, class Fractal>
+void fractalRowN(const FbmRowParams& p, float* out) {
+    fractalRow<Octaves, Octave, Fractal, false>(p, out, nullptr, nullptr);
+}
+
+template<int Octaves, class Octave, class Fractal>
+void fractalRowGradN(const FbmRowParams& p, float* out, float* outDx, float* outDz) {
+    fractalRow<Octaves, Octave, Fractal, true>(p, out, outDx, outDz);
+}
+
+// fbmPointsN for a multifractal
+template<int Octaves, class Octave, class Fractal, bool Gradients>
+void fractalPointsN(const FbmRowParams& p, const float* worldX, const float* worldZ, float* out, float* outDx, float* outDz) {
+    Octave octaves[Octaves];
+    F amplitudes[Octaves];
+    F rates[Octaves];
+    for (int o = 0; o < Octaves; o++) {
+        octaves[o].setup(p, o);
+        amplitudes[o] = F(p.tables.amplitude[o]);
+        rates[o] = F(p.tables.frequency[o] / p.scale);
+    }
+    F scale(p.scale);
+    F maxValue(p.tables.maxValue);
+
+    const int n = p.count;
+    for (int i = 0; i < n; i += F::Size) {
+        F x, z;
+        if (i + F::Size <= n) {
+            x = F::load(worldX + i) / scale;
+            z = F::load(worldZ + i) / scale;
+        }
+        else {
+            float tailX[F::Size] = {}, tailZ[F::Size] = {};
+            std::memcpy(tailX, worldX + i, (n - i) * sizeof(float));
+            std::memcpy(tailZ, worldZ + i, (n - i) * sizeof(float));
+            x = F::load(tailX) / scale;
+            z = F::load(tailZ) / scale;
+        }
+
+        Fractal fractal;
+        for (int o = 0; o < Octaves; o++) {
+            if (Gradients) {
+                F octaveDx, octaveDz;
+                F value = octaves[o].samplePointGrad(x, z, octaveDx, octaveDz);
+                fractal.template add<true>(value, octaveDx * rates[o], octaveDz * rates[o], amplitudes[o]);
+            }
+            else {
+                fractal.template add<false>(octaves[o].samplePoint(x, z), F(0.0f), F(0.0f), amplitudes[o]);
+            }
+        }
+        F dx, dz;
+        storeRowBatch(fractal.finish(maxValue, dx, dz), out, i, n);
+        if (Gradients) {
+            storeRowBatch(dx, outDx, i, n);
+            storeRowBatch(dz, outDz, i, n);
+        }
+    }
+}
+
+// No octaves means no noise: flat rather than the 0 / 0 the normalization would give
+void fbmRowZero(const FbmRowParams& p, float* out) {
+    for (int x = 0; x < p.count; x++) out[x] = 0.0f;
+}
+
+void fbmRowGradZero(const FbmRowParams& p, float* out, float* outDx, float* outDz) {
+    for (int x = 0; x < p.count; x++) out[x] = outDx[x] = outDz[x] = 0.0f;
+}
+
+void fbmPointsZero(const FbmRowParams& p, const float* /*worldX*/, const float* /*worldZ*/, float* out, float* outDx, float* outDz) {
+    for (int i = 0; i < p.count; i++) out[i] = 0.0f;
+    if (outDx) for (int i = 0; i < p.count; i++) outDx[i] = outDz[i] = 0.0f;
+}
+
+template<class Octave>
+FbmRowFn fbmRowKernelFor(int octaves) {
+    static const FbmRowFn kernels[FBM_MAX_OCTAVES + 1] = {
+        fbmRowZero,
+        fbmRowN<1, Octave>, fbmRowN<2, Octave>, fbmRowN<3, Octave>, fbmRowN<4, Octave>, fbmRowN<5, Octave>,
+        fbmRowN<6, Octave>, fbmRowN<7, Octave>, fbmRowN<8, Octave>, fbmRowN<9, Octave>, fbmRowN<10, Octave>
+    };
+    return kernels[std::max(0, std::min(octaves, FBM_MAX_OCTAVES))];
+}
+
+template<class Octave>
+FbmRowGradFn fbmRowGradKernelFor(int octaves) {
+    static const FbmRowGradFn kernels[FBM_MAX_OCTAVES + 1] = {
+        fbmRowGradZero,
+        fbmRowGradN<1, Octave>, fbmRowGradN<2, Octave>, fbmRowGradN<3, Octave>, fbmRowGradN<4, Octave>, fbmRowGradN<5, Octave>,
+        fbmRowGradN<6, Octave>, fbmRowGradN<7, Octave>, fbmRowGradN<8, Octave>, fbmRowGradN<9, Octave>, fbmRowGradN<10, Octave>
+    };
+    return kernels[std::max(0, std::min(octaves, FBM_MAX_OCTAVES))];
+}
+
+template<class Octave, bool Gradients>
+FbmPointsFn fbmPointsKernelFor(int octaves) {
+    static const FbmPointsFn kernels[FBM_MAX_OCTAVES + 1] = {
+        fbmPointsZero,
+        fbmPointsN<1, Octave, Gradients>, fbmPointsN<2, Octave, Gradients>, fbmPointsN<3, Octave, Gradients>,
+        fbmPointsN<4, Octave, Gradients>, fbmPointsN<5, Octave, Gradients>, fbmPointsN<6, Octave, Gradients>,
+        fbmPointsN<7, Octave, Gradients>, fbmPointsN<8, Octave, Gradients>, fbmPointsN<9, Octave, Gradients>,
+        fbmPointsN<10, Octave, Gradients>
+    };
+    return kernels[std::max(0, std::min(octaves, FBM_MAX_OCTAVES))];
+}
+
+template<class Octave, class Fractal>
+FbmRowFn fractalRowKernelFor(int octaves) {
+    static const FbmRowFn kernels[FBM_MAX_OCTAVES + 1] = {
+        fbmRowZero,
+        fractalRowN<1, Octave, Fractal>, fractalRowN<2, Octave, Fractal>, fractalRowN<3, Octave, Fractal>,
+        fractalRowN<4, Octave, Fractal>, fractalRowN<5, Octave, Fractal>, fractalRowN<6, Octave, Fractal>,
+        fractalRowN<7, Octave, Fractal>, fractalRowN<8, Octave, Fractal>, fractalRowN<9, Octave, Fractal>,
+        fractalRowN<10, Octave, Fractal>
+    };
+    return kernels[std::max(0, std::min(octaves, FBM_MAX_OCTAVES))];
+}
+
+template<class Octave, class Fractal>
+FbmRowGradFn fractalRowGradKernelFor(int octaves) {
+    static const FbmRowGradFn kernels[FBM_MAX_OCTAVES + 1] = {
+        fbmRowGradZero,
+        fractalRowGradN<1, Octave, Fractal>, fractalRowGradN<2, Octave, Fractal>, fractalRowGradN<3, Octave, Fractal>,
+        fractalRowGradN<4, Octave, Fractal>, fractalRowGradN<5, Octave, Fractal>, fractalRowGradN<6, Octave, Fractal>,
+        fractalRowGradN<7, Octave, Fractal>, fractalRowGradN<8, Octave, Fractal>, fractalRowGradN<9, Octave, Fractal>,
+        fractalRowGradN<10, Octave, Fractal>
+    };
+    return kernels[std::max(0, std::min(octaves, FBM_MAX_OCTAVES))];
+}
+
+template<class Octave, class Fractal, bool Gradients>
+FbmPointsFn fractalPointsKernelFor(int octaves) {
+    static const FbmPointsFn kernels[FBM_MAX_OCTAVES + 1] = {
+        fbmPointsZero,
+        fractalPointsN<1, Octave, Fractal, Gradients>, fractalPointsN<2, Octave, Fractal, Gradients>,
+        fractalPointsN<3, Octave, Fractal, Gradients>, fractalPointsN<4, Octave, Fractal, Gradients>,
+        fractalPointsN<5, Octave, Fractal, Gradients>, fractalPointsN<6, Octave, Fractal, Gradients>,
+        fractalPointsN<7, Octave, Fractal, Gradients>, fractalPointsN<8, Octave, Fractal, Gradients>,
+        fractalPointsN<9, Octave, Fractal, Gradients>, fractalPointsN<10, Octave, Fractal, Gradients>
+    };
+    return kernels[std::max(0, std::min(octaves, FBM_MAX_OCTAVES))];
+}
+
+template<class Octave>
+FbmRowFn fbmRowKernelFor(int octaves, FractalType fractal) {
+    switch (fractal) {
+    case FractalType::Ridged: return fractalRowKernelFor<Octave, RidgedFractal>(octaves);
+    case FractalType::Billow: return fractalRowKernelFor<Octave, BillowFractal>(octaves);
+    case FractalType::Hybrid: return fractalRowKernelFor<Octave, HybridFractal>(octaves);
+    default: return fbmRowKernelFor<Octave>(octaves);
+    }
+}
+
+template<class Octave>
+FbmRowGradFn fbmRowGradKernelFor(int octaves, FractalType fractal) {
+    switch (fractal) {
+    case FractalType::Ridged: return fractalRowGradKernelFor<Octave, RidgedFractal>(octaves);
+    case FractalType::Billow: return fractalRowGradKernelFor<Octave, BillowFractal>(octaves);
+    case FractalType::Hybrid: return fractalRowGradKernelFor<Octave, HybridFractal>(octaves);
+    default: return fbmRowGradKernelFor<Octave>(octaves);
+    }
+}
+
+template<class Octave>
+FbmPointsFn fbmPointsKernelFor(int octaves, bool gradients, FractalType fractal) {
+    switch (fractal) {
+    case FractalType::Ridged:
+        return gradients ? fractalPointsKernelFor<Octave, RidgedFractal, true>(octaves) : fractalPointsKernelFor<Octave, RidgedFractal, false>(octaves);
+    case FractalType::Billow:
+        return gradients ? fractalPointsKernelFor<Octave, BillowFractal, true>(octaves) : fractalPointsKernelFor<Octave, BillowFractal, false>(octaves);
+    case FractalType::Hybrid:
+        return gradients ? fractalPointsKernelFor<Octave, HybridFractal, true>(octaves) : fractalPointsKernelFor<Octave, HybridFractal, false>(octaves);
+    default:
+        return gradients ? fbmPointsKernelFor<Octave, true>(octaves) : fbmPointsKernelFor<Octave, false>(octaves);
+    }
+}
+
+// Dispatch table lookup for this instruction set
+FbmRowFn fbmRowKernel(NoiseMode mode, int octaves, FractalType fractal) {
+    switch (mode) {
+    case NoiseMode::Seeded2D: return fbmRowKernelFor<Seeded2DOctave>(octaves, fractal);
+    case NoiseMode::Simplex3D: return fbmRowKernelFor<Simplex3DOctave>(octaves, fractal);
+    case NoiseMode::OpenSimplex2: return fbmRowKernelFor<OpenSimplex2Octave>(octaves, fractal);
+    case NoiseMode::Value2D: return fbmRowKernelFor<Value2DOctave>(octaves, fractal);
+    default: return fbmRowKernelFor<Perlin3DOctave>(octaves, fractal);
+    }
+}
+
+FbmRowGradFn fbmRowGradKernel(NoiseMode mode, int octaves, FractalType fractal) {
+    switch (mode) {
+    case NoiseMode::Seeded2D: return fbmRowGradKernelFor<Seeded2DOctave>(octaves, fractal);
+    case NoiseMode::Simplex3D: return fbmRowGradKernelFor<Simplex3DOctave>(octaves, fractal);
+    case NoiseMode::OpenSimplex2: return fbmRowGradKernelFor<OpenSimplex2Octave>(octaves, fractal);
+    case NoiseMode::Value2D: return fbmRowGradKernelFor<Value2DOctave>(octaves, fractal);
+    default: return fbmRowGradKernelFor<Perlin3DOctave>(octaves, fractal);
+    }
+}
+
+FbmPointsFn fbmPointsKernel(NoiseMode mode, int octaves, bool gradients, FractalType fractal) {
+    switch (mode) {
+    case NoiseMode::Seeded2D: return fbmPointsKernelFor<Seeded2DOctave>(octaves, gradients, fractal);
+    case NoiseMode::Simplex3D: return fbmPointsKernelFor<Simplex3DOctave>(octaves, gradients, fractal);
+    case NoiseMode::OpenSimplex2: return fbmPointsKernelFor<OpenSimplex2Octave>(octaves, gradients, fractal);
+    case NoiseMode::Value2D: return fbmPointsKernelFor<Value2DOctave>(octaves, gradients, fractal);
+    default: return fbmPointsKernelFor<Perlin3DOctave>(octaves, gradients, fractal);
+    }
+}
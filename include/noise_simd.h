@@ -0,0 +1,424 @@
+#ifndef NOISE_SIMD_H
+#define NOISE_SIMD_H
+
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+// Batched noise kernels. The same kernel source (noise_kernels.inl) is compiled once per
+// instruction set inside its own namespace, and the widest one the CPU supports is picked
+// at runtime, so the executable still runs on machines without AVX2.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define TG_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#else
+#define TG_SIMD_X86 0
+#endif
+
+// GCC and Clang only allow intrinsics inside functions compiled for that instruction set,
+// MSVC allows them everywhere and needs nothing here.
+#define TG_TARGET_PRAGMA(x) _Pragma(#x)
+#if defined(__clang__)
+#define TG_TARGET_BEGIN(isa) TG_TARGET_PRAGMA(clang attribute push(__attribute__((target(isa))), apply_to = function))
+#define TG_TARGET_END _Pragma("clang attribute pop")
+#elif defined(__GNUC__)
+#define TG_TARGET_BEGIN(isa) _Pragma("GCC push_options") TG_TARGET_PRAGMA(GCC target(isa))
+#define TG_TARGET_END _Pragma("GCC pop_options")
+#else
+#define TG_TARGET_BEGIN(isa)
+#define TG_TARGET_END
+#endif
+
+// Noise backends. Each one is an octave sampler struct in noise_kernels.inl, plugged into the
+// fBm row kernels as a template parameter, so the octave loop is inlined for every backend and
+// this enum is only looked at once per kernel lookup.
+enum class NoiseMode {
+    Perlin3D,       // glm-compatible 3D Perlin, seed moves the sampling plane along Y
+    Seeded2D,       // 2D gradient noise, seed keys the lattice hash (4 corners instead of 8)
+    Simplex3D,      // glm-compatible 3D simplex, seed moves the sampling plane along Y (4 corners)
+    OpenSimplex2,   // OpenSimplex2-style 2D simplex, seed keys the lattice hash (3 corners)
+    Value2D         // Hashed value noise, seed keys the lattice hash (4 corners, no gradients)
+};
+
+const int NOISE_MODE_COUNT = 5;
+
+// How the octaves are combined. All of them come out normalized to about [-1, 1]; the
+// multifractals are structs in noise_kernels.inl plugged into the same kernels as the backends.
+enum class FractalType {
+    Fbm,        // Sum of the octaves
+    Ridged,     // Musgrave ridged multifractal: sharp ridges, detail builds up along them
+    Billow,     // Sum of folded octaves: rounded hills, creased valleys
+    Hybrid      // Musgrave hybrid multifractal: smooth valleys, rough peaks
+};
+
+const int FRACTAL_TYPE_COUNT = 4;
+
+enum class SimdLevel {
+    Scalar,
+    SSE41,
+    AVX2
+};
+
+// Highest octave count with a specialized kernel, matches the "Octaves" slider range
+const int FBM_MAX_OCTAVES = 10;
+
+// Everything in the octave loop that only depends on the slider parameters, computed
+// once per generateTerrain call instead of once per vertex
+struct FbmTables {
+    int octaves;
+    float frequency[FBM_MAX_OCTAVES];   // frequency * lacunarity^o
+    float amplitude[FBM_MAX_OCTAVES];   // persistence^o
+    float maxValue;                     // sum of the amplitudes, for normalization
+};
+
+FbmTables makeFbmTables(int octaves, float persistence, float frequency, float lacunarity) {
+    FbmTables tables;
+    tables.octaves = std::max(0, std::min(octaves, FBM_MAX_OCTAVES));
+
+    float amplitude = 1.0f;
+    tables.maxValue = 0.0f;
+    for (int o = 0; o < tables.octaves; o++) {
+        tables.frequency[o] = frequency * std::pow(lacunarity, o); // Adjust frequency using lacunarity
+        tables.amplitude[o] = amplitude;
+        tables.maxValue += amplitude;
+        amplitude *= persistence; // Reduce amplitude with persistence
+    }
+    return tables;
+}
+
+// Drops trailing octaves that can't show at this vertex spacing (in world units): ones whose
+// lattice is finer than two vertices, which would only alias, and ones whose amplitudes
+// summed with everything dropped after them stay under tolerance height units. maxValue is
+// kept, so the remaining octaves come out exactly as before. Returns the octaves left.
+int cullFbmOctaves(FbmTables& tables, float scale, float sampleSpacing, float heightScale, float tolerance) {
+    if (scale <= 0.0f || sampleSpacing <= 0.0f || tables.maxValue <= 0.0f) return tables.octaves;
+    float nyquist = 0.5f / sampleSpacing;   // Cycles per world unit
+    float dropped = 0.0f;
+    while (tables.octaves > 0) {
+        int o = tables.octaves - 1;
+        bool aliased = tables.frequency[o] / scale > nyquist;
+        // Both noise types stay within about [-1, 1] per octave
+        bool negligible = (dropped + tables.amplitude[o]) / tables.maxValue * std::fabs(heightScale) < tolerance;
+        if (!aliased && !negligible) break;
+        dropped += tables.amplitude[o];
+        tables.octaves--;
+    }
+    return tables.octaves;
+}
+
+// Octaves [first, first + count) of tables on their own, not normalized (maxValue 1), so the
+// caller can sum slices evaluated separately and normalize once
+FbmTables sliceFbmTables(const FbmTables& tables, int first, int count) {
+    FbmTables slice;
+    slice.octaves = std::max(0, std::min(count, tables.octaves - first));
+    for (int o = 0; o < slice.octaves; o++) {
+        slice.frequency[o] = tables.frequency[first + o];
+        slice.amplitude[o] = tables.amplitude[first + o];
+    }
+    slice.maxValue = 1.0f;
+    return slice;
+}
+
+// Parameters for one row of normalized fBm, shared by every kernel
+struct FbmRowParams {
+    float xOffset;
+    float halfWidth;    // width / 2, vertex x sits at worldX = (x + xOffset) - halfWidth
+    float worldZ;
+    float scale;
+    float seed;
+    int count;          // number of vertices in the row
+    NoiseMode mode;
+    FbmTables tables;
+    int firstOctave;    // Octave number of tables entry 0, when tables is a slice of a longer chain
+};
+
+// Hash key for one octave of the seeded 2D noise. Every octave gets its own key so the
+// lattices of octaves with integer lacunarity don't line up on top of each other.
+uint32_t seedKeyForOctave(float seed, int octave) {
+    uint32_t key;
+    std::memcpy(&key, &seed, sizeof(key));
+    key ^= (uint32_t)octave * 0x9E3779B9u;
+    key = (key ^ (key >> 16)) * 0x85EBCA6Bu;
+    key = (key ^ (key >> 13)) * 0xC2B2AE35u;
+    return key ^ (key >> 16);
+}
+
+typedef void (*FbmRowFn)(const FbmRowParams& params, float* out);
+
+// Row of normalized fBm plus its derivatives along world x and z
+typedef void (*FbmRowGradFn)(const FbmRowParams& params, float* out, float* outDx, float* outDz);
+
+// Normalized fBm at params.count scattered world positions, derivatives optional
+typedef void (*FbmPointsFn)(const FbmRowParams& params, const float* worldX, const float* worldZ, float* out, float* outDx, float* outDz);
+
+// ---------------------------------------------------------------------------
+// Scalar fallback, one sample per "batch"
+// ---------------------------------------------------------------------------
+namespace simd_scalar {
+    struct F {
+        float v;
+        F() {}
+        F(float s) : v(s) {}
+        static const int Size = 1;
+        static F load(const float* p) { return F(*p); }
+        static F ramp(float start) { return F(start); }
+        void store(float* p) const { *p = v; }
+    };
+    struct I {
+        uint32_t v;
+        I() {}
+        I(uint32_t s) : v(s) {}
+    };
+    typedef bool M;
+
+    inline F operator+(F a, F b) { return F(a.v + b.v); }
+    inline F operator-(F a, F b) { return F(a.v - b.v); }
+    inline F operator*(F a, F b) { return F(a.v * b.v); }
+    inline F operator/(F a, F b) { return F(a.v / b.v); }
+    inline F floor(F a) { return F(std::floor(a.v)); }
+    inline F abs(F a) { return F(std::fabs(a.v)); }
+    inline M lessThan(F a, F b) { return a.v < b.v; }
+    inline F select(M m, F a, F b) { return m ? a : b; }
+
+    inline I operator+(I a, I b) { return I(a.v + b.v); }
+    inline I operator*(I a, I b) { return I(a.v * b.v); }
+    inline I operator^(I a, I b) { return I(a.v ^ b.v); }
+    inline I operator&(I a, I b) { return I(a.v & b.v); }
+    inline I operator>>(I a, int n) { return I(a.v >> n); }
+    inline M bitClear(I a, uint32_t bit) { return (a.v & bit) == 0; }
+    // Truncating conversion with the same out-of-range result as cvttps2dq
+    inline I toInt(F a) { return I(std::fabs(a.v) < 2147483648.0f ? (uint32_t)(int32_t)a.v : 0x80000000u); }
+    inline F toFloat(I a) { return F((float)(int32_t)a.v); }    // Lanes read as signed
+
+#include "noise_kernels.inl"
+}
+
+#if TG_SIMD_X86
+// ---------------------------------------------------------------------------
+// SSE4.1, 4 samples per batch (needs roundps for floor)
+// ---------------------------------------------------------------------------
+TG_TARGET_BEGIN("sse4.1")
+namespace simd_sse41 {
+    struct F {
+        __m128 v;
+        F() {}
+        F(__m128 x) : v(x) {}
+        F(float s) : v(_mm_set1_ps(s)) {}
+        static const int Size = 4;
+        static F load(const float* p) { return F(_mm_loadu_ps(p)); }
+        static F ramp(float start) { return F(_mm_add_ps(_mm_set1_ps(start), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f))); }
+        void store(float* p) const { _mm_storeu_ps(p, v); }
+    };
+    struct I {
+        __m128i v;
+        I() {}
+        I(__m128i x) : v(x) {}
+        I(uint32_t s) : v(_mm_set1_epi32((int)s)) {}
+    };
+    typedef F M;
+
+    inline F operator+(F a, F b) { return F(_mm_add_ps(a.v, b.v)); }
+    inline F operator-(F a, F b) { return F(_mm_sub_ps(a.v, b.v)); }
+    inline F operator*(F a, F b) { return F(_mm_mul_ps(a.v, b.v)); }
+    inline F operator/(F a, F b) { return F(_mm_div_ps(a.v, b.v)); }
+    inline F floor(F a) { return F(_mm_floor_ps(a.v)); }
+    inline F abs(F a) { return F(_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)); }
+    inline M lessThan(F a, F b) { return F(_mm_cmplt_ps(a.v, b.v)); }
+    inline F select(M m, F a, F b) { return F(_mm_blendv_ps(b.v, a.v, m.v)); }
+
+    inline I operator+(I a, I b) { return I(_mm_add_epi32(a.v, b.v)); }
+    inline I operator*(I a, I b) { return I(_mm_mullo_epi32(a.v, b.v)); }
+    inline I operator^(I a, I b) { return I(_mm_xor_si128(a.v, b.v)); }
+    inline I operator&(I a, I b) { return I(_mm_and_si128(a.v, b.v)); }
+    inline I operator>>(I a, int n) { return I(_mm_srli_epi32(a.v, n)); }
+    inline M bitClear(I a, uint32_t bit) { return F(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(a.v, _mm_set1_epi32((int)bit)), _mm_setzero_si128()))); }
+    inline I toInt(F a) { return I(_mm_cvttps_epi32(a.v)); }
+    inline F toFloat(I a) { return F(_mm_cvtepi32_ps(a.v)); }
+
+#include "noise_kernels.inl"
+}
+TG_TARGET_END
+
+// ---------------------------------------------------------------------------
+// AVX2, 8 samples per batch. FMA is deliberately left off so every path rounds the same way.
+// ---------------------------------------------------------------------------
+TG_TARGET_BEGIN("avx2")
+namespace simd_avx2 {
+    struct F {
+        __m256 v;
+        F() {}
+        F(__m256 x) : v(x) {}
+        F(float s) : v(_mm256_set1_ps(s)) {}
+        static const int Size = 8;
+        static F load(const float* p) { return F(_mm256_loadu_ps(p)); }
+        static F ramp(float start) { return F(_mm256_add_ps(_mm256_set1_ps(start), _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f))); }
+        void store(float* p) const { _mm256_storeu_ps(p, v); }
+    };
+    struct I {
+        __m256i v;
+        I() {}
+        I(__m256i x) : v(x) {}
+        I(uint32_t s) : v(_mm256_set1_epi32((int)s)) {}
+    };
+    typedef F M;
+
+    inline F operator+(F a, F b) { return F(_mm256_add_ps(a.v, b.v)); }
+    inline F operator-(F a, F b) { return F(_mm256_sub_ps(a.v, b.v)); }
+    inline F operator*(F a, F b) { return F(_mm256_mul_ps(a.v, b.v)); }
+    inline F operator/(F a, F b) { return F(_mm256_div_ps(a.v, b.v)); }
+    inline F floor(F a) { return F(_mm256_floor_ps(a.v)); }
+    inline F abs(F a) { return F(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)); }
+    inline M lessThan(F a, F b) { return F(_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)); }
+    inline F select(M m, F a, F b) { return F(_mm256_blendv_ps(b.v, a.v, m.v)); }
+
+    inline I operator+(I a, I b) { return I(_mm256_add_epi32(a.v, b.v)); }
+    inline I operator*(I a, I b) { return I(_mm256_mullo_epi32(a.v, b.v)); }
+    inline I operator^(I a, I b) { return I(_mm256_xor_si256(a.v, b.v)); }
+    inline I operator&(I a, I b) { return I(_mm256_and_si256(a.v, b.v)); }
+    inline I operator>>(I a, int n) { return I(_mm256_srli_epi32(a.v, n)); }
+    inline M bitClear(I a, uint32_t bit) { return F(_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(a.v, _mm256_set1_epi32((int)bit)), _mm256_setzero_si256()))); }
+    inline I toInt(F a) { return I(_mm256_cvttps_epi32(a.v)); }
+    inline F toFloat(I a) { return F(_mm256_cvtepi32_ps(a.v)); }
+
+#include "noise_kernels.inl"
+}
+TG_TARGET_END
+#endif
+
+// Checks what the CPU (and OS, for the AVX register state) supports
+SimdLevel detectSimdLevel() {
+#if TG_SIMD_X86
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuidex(info, 1, 0);
+    ecx = (unsigned int)info[2];
+#else
+    int maxLeaf = (int)__get_cpuid_max(0, nullptr);
+    __cpuid_count(1, 0, eax, ebx, ecx, edx);
+#endif
+    bool sse41 = (ecx & (1u << 19)) != 0;
+    bool osxsave = (ecx & (1u << 27)) != 0;
+    bool avx = (ecx & (1u << 28)) != 0;
+
+    bool avx2 = false;
+    if (osxsave && avx && maxLeaf >= 7) {
+#if defined(_MSC_VER)
+        unsigned long long xcr0 = _xgetbv(0);
+        __cpuidex(info, 7, 0);
+        ebx = (unsigned int)info[1];
+#else
+        unsigned int xcr0Lo, xcr0Hi;
+        __asm__("xgetbv" : "=a"(xcr0Lo), "=d"(xcr0Hi) : "c"(0));
+        unsigned long long xcr0 = ((unsigned long long)xcr0Hi << 32) | xcr0Lo;
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+#endif
+        bool ymmEnabled = (xcr0 & 0x6) == 0x6;
+        avx2 = ymmEnabled && (ebx & (1u << 5)) != 0;
+    }
+
+    if (avx2) return SimdLevel::AVX2;
+    if (sse41) return SimdLevel::SSE41;
+#endif
+    return SimdLevel::Scalar;
+}
+
+SimdLevel& activeSimdLevel() {
+    static SimdLevel level = detectSimdLevel();
+    return level;
+}
+
+const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::AVX2: return "AVX2";
+    case SimdLevel::SSE41: return "SSE4.1";
+    default: return "Scalar";
+    }
+}
+
+const char* noiseModeName(NoiseMode mode) {
+    switch (mode) {
+    case NoiseMode::Seeded2D: return "Seeded Perlin 2D";
+    case NoiseMode::Simplex3D: return "Simplex 3D (seed as Y)";
+    case NoiseMode::OpenSimplex2: return "OpenSimplex2 2D";
+    case NoiseMode::Value2D: return "Value noise 2D";
+    default: return "Perlin 3D (seed as Y)";
+    }
+}
+
+const char* fractalTypeName(FractalType fractal) {
+    switch (fractal) {
+    case FractalType::Ridged: return "Ridged multifractal";
+    case FractalType::Billow: return "Billow";
+    case FractalType::Hybrid: return "Hybrid multifractal";
+    default: return "fBm";
+    }
+}
+
+// The kernels below work on any slice of an fBm octave chain (see sliceFbmTables); the
+// multifractals weight each octave by the ones before it, so they only take whole chains.
+FbmRowFn getFbmRowKernel(SimdLevel level, NoiseMode mode, int octaves, FractalType fractal = FractalType::Fbm) {
+#if TG_SIMD_X86
+    if (level == SimdLevel::AVX2) return simd_avx2::fbmRowKernel(mode, octaves, fractal);
+    if (level == SimdLevel::SSE41) return simd_sse41::fbmRowKernel(mode, octaves, fractal);
+#endif
+    return simd_scalar::fbmRowKernel(mode, octaves, fractal);
+}
+
+FbmRowGradFn getFbmRowGradKernel(SimdLevel level, NoiseMode mode, int octaves, FractalType fractal = FractalType::Fbm) {
+#if TG_SIMD_X86
+    if (level == SimdLevel::AVX2) return simd_avx2::fbmRowGradKernel(mode, octaves, fractal);
+    if (level == SimdLevel::SSE41) return simd_sse41::fbmRowGradKernel(mode, octaves, fractal);
+#endif
+    return simd_scalar::fbmRowGradKernel(mode, octaves, fractal);
+}
+
+FbmPointsFn getFbmPointsKernel(SimdLevel level, NoiseMode mode, int octaves, bool gradients, FractalType fractal = FractalType::Fbm) {
+#if TG_SIMD_X86
+    if (level == SimdLevel::AVX2) return simd_avx2::fbmPointsKernel(mode, octaves, gradients, fractal);
+    if (level == SimdLevel::SSE41) return simd_sse41::fbmPointsKernel(mode, octaves, gradients, fractal);
+#endif
+    return simd_scalar::fbmPointsKernel(mode, octaves, gradients, fractal);
+}
+
+// Single-octave noise samples per second of one backend on one instruction set, timed over
+// 256-vertex rows for at least the given time. For comparing backends against each other.
+double noiseSamplesPerSecond(SimdLevel level, NoiseMode mode, double seconds = 0.05) {
+    FbmRowParams params;
+    params.xOffset = 0.0f;
+    params.halfWidth = 128.0f;
+    params.scale = 50.0f;
+    params.seed = 1337.0f;
+    params.count = 256;
+    params.mode = mode;
+    params.tables = makeFbmTables(1, 0.5f, 2.0f, 2.0f);
+    params.firstOctave = 0;
+    FbmRowFn kernel = getFbmRowKernel(level, mode, 1);
+    std::vector<float> row(params.count);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double elapsed = 0.0;
+    long long rows = 0;
+    while (elapsed < seconds) {
+        // A batch of rows between clock reads, each at a new z so nothing is cached
+        for (int i = 0; i < 64; i++, rows++) {
+            params.worldZ = (float)rows;
+            kernel(params, row.data());
+        }
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return rows * (double)params.count / elapsed;
+}
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef RTIN_MESH_H
+#define RTIN_MESH_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "noise.h"
+
+// Right-triangulated irregular network (RTIN) meshes for square grids of 2^k + 1 vertices, after
+// Evans et al. and Agafonkin's Martini. The grid is the root of a binary tree of right
+// triangles: the two halves of the square, each split at the midpoint of its hypotenuse into two
+// smaller right triangles, down to single cells. A vertex's error is how far the grid's height
+// there is from the line across the hypotenuse it splits, raised to the error of every vertex
+// below it in the tree. Splitting wherever that error is over the tolerance gives a mesh with no
+// T-junctions inside the grid, and building it only visits the triangles it keeps.
+//
+// Meshes index the chunk's full vertex grid (vertex (x, z) is z * size + x), so the vertex
+// buffer and every vertex format stay as they are and only the indices change.
+
+// True for square grids of 2^k + 1 vertices, k >= 1
+bool rtinGridFits(int width, int height) {
+    int quads = width - 1;
+    return width == height && quads >= 2 && (quads & (quads - 1)) == 0;
+}
+
+// Height of every vertex of the chunk, decoded from its format
+void terrainVertexHeights(const TerrainData& terrain, std::vector<float>& heights) {
+    switch (terrain.format) {
+    case VertexFormat::Position3f:
+    case VertexFormat::PositionNormal3f: {
+        size_t stride = terrain.format == VertexFormat::Position3f ? 3 : 6;
+        heights.resize(terrain.vertices.size() / stride);
+        for (size_t i = 0; i < heights.size(); i++) heights[i] = terrain.vertices[i * stride + 1];
+        break;
+    }
+    case VertexFormat::HeightFloat:
+        heights = terrain.heights;
+        break;
+    case VertexFormat::HeightUnorm16:
+        heights.resize(terrain.packedHeights.size());
+        for (size_t i = 0; i < heights.size(); i++) heights[i] = terrain.heightBias + terrain.packedHeights[i] / 65535.0f * terrain.heightRange;
+        break;
+    }
+}
+
+// Fills errors (size * size) with the error hierarchy of the heights. errorFloor, when given,
+// is a minimum error per vertex that is raised through the hierarchy like a measured one.
+// Triangles are visited smallest first, so every vertex has its final error before the
+// triangles above it read it.
+void computeRtinErrors(int size, const float* heights, const float* errorFloor, float* errors) {
+    const int quads = size - 1;
+    const int triangles = quads * quads * 2 - 2;    // Every triangle with a hypotenuse midpoint
+    const int parents = triangles - quads * quads;  // Those whose children have one too
+    if (errorFloor) std::copy(errorFloor, errorFloor + (size_t)size * size, errors);
+    else std::fill(errors, errors + (size_t)size * size, 0.0f);
+
+    for (int i = triangles - 1; i >= 0; i--) {
+        // Triangle i + 2 of the tree in heap order: bit 0 picks the half of the square, each
+        // further bit the left or right child
+        int id = i + 2;
+        int ax = 0, az = 0, bx = 0, bz = 0, cx = 0, cz = 0;
+        // The two halves of the square, as buildRtinIndices starts them
+        if (id & 1) {
+            bx = bz = cx = quads;
+        }
+        else {
+            ax = az = cz = quads;
+        }
+        while ((id >>= 1) > 1) {
+            int mx = (ax + bx) >> 1;
+            int mz = (az + bz) >> 1;
+            if (id & 1) {
+                bx = ax;
+                bz = az;
+                ax = cx;
+                az = cz;
+            }
+            else {
+                ax = bx;
+                az = bz;
+                bx = cx;
+                bz = cz;
+            }
+            cx = mx;
+            cz = mz;
+        }
+
+        int mx = (ax + bx) >> 1;
+        int mz = (az + bz) >> 1;
+        size_t middle = (size_t)mz * size + mx;
+        float interpolated = (heights[(size_t)az * size + ax] + heights[(size_t)bz * size + bx]) * 0.5f;
+        float error = std::max(errors[middle], std::fabs(interpolated - heights[middle]));
+        if (i < parents) {
+            // The children's hypotenuse midpoints, halfway from the right angle to a and to b
+            error = std::max(error, errors[(size_t)((az + cz) >> 1) * size + ((ax + cx) >> 1)]);
+            error = std::max(error, errors[(size_t)((bz + cz) >> 1) * size + ((bx + cx) >> 1)]);
+        }
+        errors[middle] = error;
+    }
+}
+
+// Appends triangle (a, b, c) if it's within tolerance, or its two children otherwise. a and b
+// end the hypotenuse, c is the right angle.
+template<class Index>
+void appendRtinTriangle(int size, const float* errors, float tolerance, int ax, int az, int bx, int bz, int cx, int cz, std::vector<Index>& indices) {
+    int mx = (ax + bx) >> 1;
+    int mz = (az + bz) >> 1;
+    if (std::abs(ax - cx) + std::abs(az - cz) > 1 && errors[(size_t)mz * size + mx] > tolerance) {
+        appendRtinTriangle(size, errors, tolerance, cx, cz, ax, az, mx, mz, indices);
+        appendRtinTriangle(size, errors, tolerance, bx, bz, cx, cz, mx, mz, indices);
+        return;
+    }
+    // Same winding as generateTerrainIndexRows
+    indices.push_back((Index)(az * size + ax));
+    indices.push_back((Index)(bz * size + bx));
+    indices.push_back((Index)(cz * size + cx));
+}
+
+// Triangle list of the RTIN mesh that splits every triangle whose error is over tolerance. The
+// errors are measured against each split's hypotenuse rather than the final surface, so a
+// dropped vertex can end up a little further than tolerance from it.
+template<class Index>
+void buildRtinIndices(int size, const float* errors, float tolerance, std::vector<Index>& indices) {
+    const int quads = size - 1;
+    indices.clear();
+    appendRtinTriangle(size, errors, tolerance, 0, 0, quads, quads, quads, 0, indices);
+    appendRtinTriangle(size, errors, tolerance, quads, quads, 0, 0, 0, quads, indices);
+}
+
+#endif
@@ -70,6 +70,30 @@ public:
         glDeleteShader(fragment);
 
     }
+    // constructor for a program with tessellation stages (OpenGL 4.0): vertex, tessellation
+    // control, tessellation evaluation and fragment shader
+    // ------------------------------------------------------------------------
+    Shader(const char* vertexPath, const char* tessControlPath, const char* tessEvaluationPath, const char* fragmentPath)
+    {
+        const GLenum types[4] = { GL_VERTEX_SHADER, GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER, GL_FRAGMENT_SHADER };
+        const char* paths[4] = { vertexPath, tessControlPath, tessEvaluationPath, fragmentPath };
+        const char* names[4] = { "VERTEX", "TESS_CONTROL", "TESS_EVALUATION", "FRAGMENT" };
+        unsigned int shaders[4];
+        ID = glCreateProgram();
+        for (int i = 0; i < 4; i++)
+        {
+            std::string code = readSource(paths[i]);
+            const char* source = code.c_str();
+            shaders[i] = glCreateShader(types[i]);
+            glShaderSource(shaders[i], 1, &source, NULL);
+            glCompileShader(shaders[i]);
+            checkCompileErrors(shaders[i], names[i]);
+            glAttachShader(ID, shaders[i]);
+        }
+        glLinkProgram(ID);
+        checkCompileErrors(ID, "PROGRAM");
+        for (int i = 0; i < 4; i++) glDeleteShader(shaders[i]);
+    }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() const
@@ -136,6 +160,25 @@ public:
     }
 
 private:
+    // utility function for reading a shader's source code from a file
+    // ------------------------------------------------------------------------
+    std::string readSource(const char* path)
+    {
+        std::ifstream file;
+        file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        try
+        {
+            file.open(path);
+            std::stringstream stream;
+            stream << file.rdbuf();
+            return stream.str();
+        }
+        catch (std::ifstream::failure& e)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << path << " " << e.what() << std::endl;
+        }
+        return std::string();
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
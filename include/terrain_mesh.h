@@ -0,0 +1,252 @@
+#ifndef TERRAIN_MESH_H
+#define TERRAIN_MESH_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <list>
+#include <vector>
+#include <shader_m.h>
+#include "noise.h"
+
+// Triangle indices for a width x height grid. The pattern only depends on the grid size, so
+// one copy serves every chunk of that size. Grids small enough get 16-bit indices.
+struct IndexBuffer {
+    int width, height;
+    IndexLayout layout;
+    std::vector<uint16_t> indices16;
+    std::vector<uint32_t> indices32;
+    unsigned int EBO;
+    GLsizei count;
+    GLenum mode;            // GL_TRIANGLES or GL_TRIANGLE_STRIP
+    GLenum type;            // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    GLuint restartIndex;    // Strips only, the largest value of type
+};
+
+// Index buffers keyed by grid dimensions and layout, built and uploaded on first use. Keeps
+// the few most recently used ones so dragging the Width/height sliders doesn't pile up buffers.
+class IndexBufferCache
+{
+public:
+    explicit IndexBufferCache(size_t capacity = 4) : capacity(capacity) {}
+
+    ~IndexBufferCache()
+    {
+        clear();
+    }
+
+    IndexBufferCache(const IndexBufferCache&) = delete;
+    IndexBufferCache& operator=(const IndexBufferCache&) = delete;
+
+    // Returns the shared buffer for this size. The reference stays valid until the entry is
+    // evicted, which only happens when capacity other sizes have been requested since.
+    const IndexBuffer& get(int width, int height, IndexLayout layout = IndexLayout::TriangleList)
+    {
+        for (std::list<IndexBuffer>::iterator it = buffers.begin(); it != buffers.end(); ++it) {
+            if (it->width == width && it->height == height && it->layout == layout) {
+                buffers.splice(buffers.begin(), buffers, it); // Most recently used first
+                return buffers.front();
+            }
+        }
+
+        while (!buffers.empty() && buffers.size() >= capacity) {
+            glDeleteBuffers(1, &buffers.back().EBO);
+            buffers.pop_back();
+        }
+
+        buffers.push_front(IndexBuffer());
+        IndexBuffer& buffer = buffers.front();
+        buffer.width = width;
+        buffer.height = height;
+        buffer.layout = layout;
+        buffer.mode = layout == IndexLayout::TriangleStrip ? GL_TRIANGLE_STRIP : GL_TRIANGLES;
+
+        const void* data;
+        size_t bytes;
+        if (terrainFitsShortIndices(width, height, layout)) {
+            buffer.indices16 = generateTerrainIndices<uint16_t>(width, height, layout);
+            buffer.type = GL_UNSIGNED_SHORT;
+            buffer.restartIndex = 0xFFFF;
+            buffer.count = static_cast<GLsizei>(buffer.indices16.size());
+            data = buffer.indices16.data();
+            bytes = buffer.indices16.size() * sizeof(uint16_t);
+        }
+        else {
+            buffer.indices32 = generateTerrainIndices<uint32_t>(width, height, layout);
+            buffer.type = GL_UNSIGNED_INT;
+            buffer.restartIndex = 0xFFFFFFFF;
+            buffer.count = static_cast<GLsizei>(buffer.indices32.size());
+            data = buffer.indices32.data();
+            bytes = buffer.indices32.size() * sizeof(uint32_t);
+        }
+
+        // Upload without disturbing whichever VAO is bound
+        GLint boundVAO = 0;
+        glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &boundVAO);
+        glBindVertexArray(0);
+        glGenBuffers(1, &buffer.EBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer.EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, bytes, data, GL_STATIC_DRAW);
+        glBindVertexArray(boundVAO);
+
+        return buffer;
+    }
+
+    void clear()
+    {
+        for (IndexBuffer& buffer : buffers) glDeleteBuffers(1, &buffer.EBO);
+        buffers.clear();
+    }
+
+private:
+    std::list<IndexBuffer> buffers;
+    size_t capacity;
+};
+
+// Draws the bound VAO with the shared indices, attaching them to the VAO first
+void drawTerrainIndices(const IndexBuffer& buffer) {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer.EBO);
+    if (buffer.mode == GL_TRIANGLE_STRIP) {
+        glEnable(GL_PRIMITIVE_RESTART);
+        glPrimitiveRestartIndex(buffer.restartIndex);
+    }
+    glDrawElements(buffer.mode, buffer.count, buffer.type, 0);
+    if (buffer.mode == GL_TRIANGLE_STRIP) glDisable(GL_PRIMITIVE_RESTART);
+}
+
+// Skirt vertices of a width x height grid: a copy of the first row, the last row, the first
+// column and the last column, in that order, numbered on from width * height. noiseshader.vs
+// rebuilds their x/z the same way and drops them skirtDepth below the edge they copy.
+int terrainSkirtVertexCount(int width, int height) {
+    return 2 * (width + height);
+}
+
+// Grid vertex skirt vertex i copies
+int terrainSkirtSourceVertex(int width, int height, int i) {
+    if (i < width) return i;
+    if (i < 2 * width) return (height - 1) * width + i - width;
+    if (i < 2 * width + height) return (i - 2 * width) * width;
+    return (i - 2 * width - height) * width + width - 1;
+}
+
+// Border vertices of data, components values per vertex, in skirt order
+template<class T>
+std::vector<T> gatherTerrainSkirt(const std::vector<T>& data, size_t components, int width, int height) {
+    std::vector<T> skirt((size_t)terrainSkirtVertexCount(width, height) * components);
+    for (int i = 0; i < terrainSkirtVertexCount(width, height); i++) {
+        const T* source = data.data() + (size_t)terrainSkirtSourceVertex(width, height, i) * components;
+        std::copy(source, source + components, skirt.begin() + (size_t)i * components);
+    }
+    return skirt;
+}
+
+// Uploads the chunk's vertices into VBO and points the bound VAO's attributes at them:
+// location 0 is the full position, location 1 the height of the height-only formats,
+// location 2 the normal of the lit format. LOD nodes' morph targets follow the vertices in the
+// same buffer, the height at location 3 and the normal at location 4. Chunks pass their grid
+// size as skirtWidth x skirtHeight to have skirt vertices follow the grid's instead; the two
+// don't mix, since morph targets only cover the grid.
+void uploadTerrainVertices(const TerrainData& terrain, unsigned int VBO, GLenum usage, int skirtWidth = 0, int skirtHeight = 0) {
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    size_t vertexBytes = terrain.vertices.size() * sizeof(float) + terrain.heights.size() * sizeof(float) +
+        terrain.packedHeights.size() * sizeof(uint16_t);
+    size_t skirtBytes = 0;
+    if (skirtWidth > 0 && skirtHeight > 0) {
+        skirtBytes = vertexBytes / ((size_t)skirtWidth * skirtHeight) * terrainSkirtVertexCount(skirtWidth, skirtHeight);
+    }
+    size_t morphBytes = terrain.morphTargets.size() * sizeof(float);
+    glBufferData(GL_ARRAY_BUFFER, vertexBytes + skirtBytes + morphBytes, nullptr, usage);
+    if (skirtBytes > 0) {
+        switch (terrain.format) {
+        case VertexFormat::Position3f:
+        case VertexFormat::PositionNormal3f:
+            glBufferSubData(GL_ARRAY_BUFFER, vertexBytes, skirtBytes, gatherTerrainSkirt(terrain.vertices,
+                terrain.format == VertexFormat::Position3f ? 3 : 6, skirtWidth, skirtHeight).data());
+            break;
+        case VertexFormat::HeightFloat:
+            glBufferSubData(GL_ARRAY_BUFFER, vertexBytes, skirtBytes, gatherTerrainSkirt(terrain.heights, 1, skirtWidth, skirtHeight).data());
+            break;
+        case VertexFormat::HeightUnorm16:
+            glBufferSubData(GL_ARRAY_BUFFER, vertexBytes, skirtBytes, gatherTerrainSkirt(terrain.packedHeights, 1, skirtWidth, skirtHeight).data());
+            break;
+        }
+    }
+    switch (terrain.format) {
+    case VertexFormat::Position3f:
+        glBufferSubData(GL_ARRAY_BUFFER, 0, vertexBytes, terrain.vertices.data());
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glDisableVertexAttribArray(1);
+        glDisableVertexAttribArray(2);
+        break;
+    case VertexFormat::PositionNormal3f:
+        glBufferSubData(GL_ARRAY_BUFFER, 0, vertexBytes, terrain.vertices.data());
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+        glDisableVertexAttribArray(1);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+        break;
+    case VertexFormat::HeightFloat:
+        glBufferSubData(GL_ARRAY_BUFFER, 0, vertexBytes, terrain.heights.data());
+        glDisableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)0);
+        glDisableVertexAttribArray(2);
+        break;
+    case VertexFormat::HeightUnorm16:
+        glBufferSubData(GL_ARRAY_BUFFER, 0, vertexBytes, terrain.packedHeights.data());
+        glDisableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 1, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(uint16_t), (void*)0);
+        glDisableVertexAttribArray(2);
+        break;
+    }
+
+    if (morphBytes == 0) {
+        glDisableVertexAttribArray(3);
+        glDisableVertexAttribArray(4);
+        return;
+    }
+    glBufferSubData(GL_ARRAY_BUFFER, vertexBytes + skirtBytes, morphBytes, terrain.morphTargets.data());
+    bool normals = vertexFormatHasNormals(terrain.format);
+    GLsizei stride = (normals ? 4 : 1) * sizeof(float);
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, stride, (void*)(vertexBytes + skirtBytes));
+    if (normals) {
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, stride, (void*)(vertexBytes + skirtBytes + sizeof(float)));
+    }
+    else {
+        glDisableVertexAttribArray(4);
+    }
+}
+
+// Per-chunk uniforms noiseshader.vs needs to rebuild positions for the height-only formats
+// and to light the formats with normals. Vertex (x, z) of the grid sits at world
+// (originX + x * spacing, originZ + z * spacing).
+void setTerrainChunkUniforms(const Shader& shader, const TerrainData& terrain, int width, int height, float originX, float originZ, float spacing = 1.0f) {
+    shader.setBool("heightOnly", terrain.format == VertexFormat::HeightFloat || terrain.format == VertexFormat::HeightUnorm16);
+    shader.setBool("hasNormals", vertexFormatHasNormals(terrain.format));
+    shader.setInt("gridWidth", width);
+    shader.setInt("gridHeight", height);
+    shader.setVec2("gridOrigin", originX, originZ);
+    shader.setFloat("vertexSpacing", spacing);
+    shader.setVec2("heightDecode", terrain.heightBias, terrain.heightRange);
+}
+
+// Geomorphing for LOD nodes: vertices blend into their morph targets between morphStart and
+// morphEnd world units from the camera. Chunks pass enabled = false.
+void setTerrainMorphUniforms(const Shader& shader, bool enabled, const glm::vec3& cameraPos = glm::vec3(0.0f), float morphStart = 0.0f, float morphEnd = 1.0f) {
+    shader.setBool("lodMorph", enabled);
+    shader.setVec3("cameraPosition", cameraPos);
+    shader.setVec2("morphRange", morphStart, morphEnd);
+}
+
+// Depth skirt vertices hang below the chunk edge they copy. Only drawn by the skirted chunk
+// index variants, see chunk_lod.h.
+void setTerrainSkirtUniforms(const Shader& shader, float depth) {
+    shader.setFloat("skirtDepth", depth);
+}
+
+#endif
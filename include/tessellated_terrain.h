@@ -0,0 +1,172 @@
+#ifndef TESSELLATED_TERRAIN_H
+#define TESSELLATED_TERRAIN_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <shader_m.h>
+#include "geometry_clipmap.h"
+#include "noise.h"
+
+// Terrain tessellated on the GPU (OpenGL 4.0): a coarse grid of quad patches around the camera,
+// each split by the tessellator as finely as its edges are long on screen, with every generated
+// vertex reading its height and normal off a heightmap texture. The CPU only generates the
+// heightmap, a single-level ClipmapTexture on the chunks' vertex lattice that slides with the
+// camera and fills in the strips it moves into; there are no vertices to generate or upload.
+// A patch edge's level only depends on the edge, so neighbouring patches always split their
+// shared edge the same way and never crack. Needs tessellation.vs/.tcs/.tes.
+
+// True when the context can run the tessellation stages
+bool tessellationSupported() {
+    return GLAD_GL_VERSION_4_0 != 0;
+}
+
+class TessellatedTerrain
+{
+public:
+    int textureSizeLog2 = 9;    // Heightmap texels per side; patches cover 4 fewer lattice points
+    int patchQuads = 16;        // Lattice quads per patch side, also the most an edge is split into
+    float triangleSize = 12.0f; // Screen-space length tessellation aims to cut edges down to, in pixels
+    int maxThreads = 0;         // Threads generating the heightmap, 0 = the whole pool plus the caller
+
+    TessellatedTerrain() {}
+
+    ~TessellatedTerrain()
+    {
+        clear();
+    }
+
+    TessellatedTerrain(const TessellatedTerrain&) = delete;
+    TessellatedTerrain& operator=(const TessellatedTerrain&) = delete;
+
+    // Where the far plane has to be for the furthest patch to show
+    float farDistance(const TerrainSettings& settings) const
+    {
+        return ((1 << textureSizeLog2) / 2) * 1.5f + std::fabs(settings.heightScale);
+    }
+
+    // Once per frame on the GL thread: recentres the heightmap on the camera and fits the patch
+    // grid into it
+    void update(const TerrainSettings& settings, const glm::vec3& cameraPos)
+    {
+        if (VAO == 0) create();
+        heights.maxThreads = maxThreads;
+        heights.update(settings, cameraPos, 1, textureSizeLog2);
+        heightMargin = std::fabs(settings.heightScale);
+
+        // Patches start on multiples of patchQuads, so a point of the terrain stays in the same
+        // patch as the window slides
+        const long long last = heights.windowQuads();
+        firstPatchX = ceilMultiple(heights.windowOriginX(0), patchQuads);
+        firstPatchZ = ceilMultiple(heights.windowOriginZ(0), patchQuads);
+        patchesX = (int)std::max(0LL, (heights.windowOriginX(0) + last - firstPatchX) / patchQuads);
+        patchesZ = (int)std::max(0LL, (heights.windowOriginZ(0) + last - firstPatchZ) / patchQuads);
+
+        // Last frame's count, if the GPU has it by now
+        if (queryPending) {
+            GLuint available = 0;
+            glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint primitives = 0;
+                glGetQueryObjectuiv(query, GL_QUERY_RESULT, &primitives);
+                trianglesDrawn = primitives;
+                queryPending = false;
+            }
+        }
+    }
+
+    // New settings: the whole heightmap is generated again on the next update()
+    void regenerate()
+    {
+        heights.regenerate();
+    }
+
+    // Draws the patches with the tessellation shaders; the caller sets the matrices.
+    // viewportHeight in pixels turns triangleSize into world units at a distance.
+    void draw(const Shader& shader, const glm::vec3& cameraPos, float viewportHeight)
+    {
+        if (heights.id() == 0 || patchesX == 0 || patchesZ == 0) return;
+        shader.setInt("heightmap", 0);
+        shader.setInt("textureSize", 1 << heights.sizeLog2());
+        shader.setVec2("latticeOrigin", heights.latticeOrigin());
+        glUniform2i(glGetUniformLocation(shader.ID, "firstPatch"), (int)firstPatchX, (int)firstPatchZ);
+        shader.setInt("patchesPerRow", patchesX);
+        shader.setInt("patchQuads", patchQuads);
+        shader.setVec3("cameraPosition", cameraPos);
+        shader.setFloat("viewportHeight", viewportHeight);
+        shader.setFloat("triangleSize", triangleSize);
+        // Past one vertex per texel there's no more detail in the heightmap to show
+        shader.setFloat("maxTessLevel", (float)std::min(patchQuads, maxTessLevel));
+        shader.setFloat("heightMargin", heightMargin);
+        shader.setBool("hasNormals", heights.hasNormals());
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, heights.id());
+        glBindSampler(0, sampler);
+        glBindVertexArray(VAO);
+        glPatchParameteri(GL_PATCH_VERTICES, 4);
+
+        bool counting = !queryPending;
+        if (counting) glBeginQuery(GL_PRIMITIVES_GENERATED, query);
+        glDrawArrays(GL_PATCHES, 0, patchesX * patchesZ * 4);
+        if (counting) {
+            glEndQuery(GL_PRIMITIVES_GENERATED);
+            queryPending = true;
+        }
+        glBindSampler(0, 0);
+    }
+
+    void clear()
+    {
+        heights.clear();
+        if (VAO != 0) glDeleteVertexArrays(1, &VAO);
+        if (sampler != 0) glDeleteSamplers(1, &sampler);
+        if (query != 0) glDeleteQueries(1, &query);
+        VAO = sampler = query = 0;
+        queryPending = false;
+        patchesX = patchesZ = 0;
+        trianglesDrawn = 0;
+    }
+
+    int patchCount() const { return patchesX * patchesZ; }
+    // Triangles the tessellator made, a frame or so behind
+    size_t triangleCount() const { return trianglesDrawn; }
+    size_t samplesLastUpdate() const { return heights.samplesLastUpdate(); }
+    size_t textureBytes() const { return heights.bytes(); }
+
+private:
+    // Smallest multiple of step at or above a
+    static long long ceilMultiple(long long a, long long step)
+    {
+        return -floorDivide(-a, step) * step;
+    }
+
+    void create()
+    {
+        // Patch corners come from gl_VertexID, nothing to put in the VAO
+        glGenVertexArrays(1, &VAO);
+
+        // Bilinear between lattice points, wrapping around like the window does
+        glGenSamplers(1, &sampler);
+        glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+        glGenQueries(1, &query);
+        glGetIntegerv(GL_MAX_TESS_GEN_LEVEL, &maxTessLevel);
+    }
+
+    ClipmapTexture heights;
+    unsigned int VAO = 0, sampler = 0, query = 0;
+    bool queryPending = false;
+    GLint maxTessLevel = 64;
+    long long firstPatchX = 0, firstPatchZ = 0;    // Lattice index of the first patch's first corner
+    int patchesX = 0, patchesZ = 0;
+    float heightMargin = 0.0f;
+    size_t trianglesDrawn = 0;
+};
+
+#endif
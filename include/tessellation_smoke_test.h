@@ -0,0 +1,110 @@
+#ifndef TESSELLATION_SMOKE_TEST_H
+#define TESSELLATION_SMOKE_TEST_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <iostream>
+#include <vector>
+#include <shader_m.h>
+#include "tessellated_terrain.h"
+
+// One frame of the tessellated terrain rendered into a framebuffer object, for machines without
+// a display (CI under Mesa llvmpipe). Builds the tessellation.vs/.tcs/.tes program, draws the
+// patches once and checks the program linked, GL raised no errors and the terrain covered part
+// of the frame. Needs a current OpenGL 4.x context and the shaders in the working directory.
+// Returns false and says why on stderr when anything fails.
+bool runTessellationSmokeTest(int width = 800, int height = 600) {
+    if (!tessellationSupported()) {
+        std::cerr << "Tessellation smoke test: the context has no OpenGL 4.0 tessellation stages" << std::endl;
+        return false;
+    }
+    // Drop whatever the context raised before the test started
+    while (glGetError() != GL_NO_ERROR) {}
+
+    Shader shader("tessellation.vs", "tessellation.tcs", "tessellation.tes", "noiseshader.fs");
+    GLint linked = GL_FALSE;
+    glGetProgramiv(shader.ID, GL_LINK_STATUS, &linked);
+    if (linked != GL_TRUE) {
+        std::cerr << "Tessellation smoke test: the tessellation program failed to link" << std::endl;
+        glDeleteProgram(shader.ID);
+        return false;
+    }
+
+    // Colour and depth renderbuffers, the default framebuffer may be hidden or missing
+    unsigned int FBO, colorBuffer, depthBuffer;
+    glGenFramebuffers(1, &FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+    bool passed = true;
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Tessellation smoke test: the framebuffer is incomplete" << std::endl;
+        passed = false;
+    }
+
+    std::vector<unsigned char> pixels((size_t)width * height * 4, 0);
+    if (passed) {
+        // Default settings, the camera above the terrain looking down so it fills most of the frame
+        TerrainSettings settings;
+        glm::vec3 cameraPos(0.0f, 20.0f, 3.0f);
+        TessellatedTerrain terrain;
+        terrain.update(settings, cameraPos);
+
+        glm::mat4 model = glm::mat4(1.0f);
+        glm::mat4 view = glm::lookAt(cameraPos, cameraPos + glm::vec3(1.0f, -0.5f, 0.3f), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)width / height, 0.5f, terrain.farDistance(settings));
+
+        glViewport(0, 0, width, height);
+        glEnable(GL_DEPTH_TEST);
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        shader.use();
+        shader.setMat4("model", model);
+        shader.setMat4("view", view);
+        shader.setMat4("projection", projection);
+        terrain.draw(shader, cameraPos, (float)height);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+        if (terrain.patchCount() == 0) {
+            std::cerr << "Tessellation smoke test: no patches around the camera" << std::endl;
+            passed = false;
+        }
+        terrain.clear();
+    }
+
+    GLenum error = glGetError();
+    if (error != GL_NO_ERROR) {
+        std::cerr << "Tessellation smoke test: GL error 0x" << std::hex << error << std::dec << std::endl;
+        passed = false;
+    }
+
+    // The terrain is green on the black clear colour
+    size_t covered = 0;
+    for (size_t i = 0; i < pixels.size(); i += 4)
+        if (pixels[i + 1] != 0) covered++;
+    if (passed && covered == 0) {
+        std::cerr << "Tessellation smoke test: the terrain covered no pixels" << std::endl;
+        passed = false;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteRenderbuffers(1, &colorBuffer);
+    glDeleteRenderbuffers(1, &depthBuffer);
+    glDeleteFramebuffers(1, &FBO);
+    glDeleteProgram(shader.ID);
+
+    if (passed)
+        std::cout << "Tessellation smoke test passed: " << covered << " of " << width * height << " pixels covered" << std::endl;
+    return passed;
+}
+
+#endif
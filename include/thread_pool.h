@@ -0,0 +1,145 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Number of threads to use when the caller asks for 0 (hardware concurrency, at least 1)
+int defaultThreadCount() {
+    unsigned int n = std::thread::hardware_concurrency();
+    return n > 0 ? (int)n : 1;
+}
+
+// Fixed set of worker threads pulling tasks from a shared FIFO queue
+class ThreadPool
+{
+public:
+    // threadCount = 0 uses one worker per hardware thread
+    explicit ThreadPool(int threadCount = 0)
+    {
+        if (threadCount <= 0) threadCount = defaultThreadCount();
+        for (int i = 0; i < threadCount; i++) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers) worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return (int)workers.size(); }
+
+    void submit(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        wake.notify_one();
+    }
+
+    // Calls fn(begin, end) over [0, count) split into small ranges, using up to maxThreads
+    // threads including the caller, and returns once every range is done. The caller works
+    // through ranges itself, so this never waits on a queued task and is safe to call from
+    // inside a pool task.
+    void parallelFor(int count, int maxThreads, const std::function<void(int, int)>& fn)
+    {
+        if (count <= 0) return;
+        if (maxThreads <= 0) maxThreads = size() + 1;
+        int helpers = std::min(maxThreads - 1, size());
+        if (helpers <= 0 || count == 1) {
+            fn(0, count);
+            return;
+        }
+
+        // A few ranges per thread so uneven rows still balance out
+        int threads = helpers + 1;
+        int grain = std::max(1, count / (threads * 4));
+
+        std::shared_ptr<ParallelForState> state = std::make_shared<ParallelForState>();
+        state->fn = fn;
+        state->count = count;
+        state->grain = grain;
+        state->ranges = (count + grain - 1) / grain;
+
+        for (int i = 0; i < helpers; i++) {
+            submit([state] { runRanges(*state); });
+        }
+        runRanges(*state);
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->finished.wait(lock, [&] { return state->completed == state->ranges; });
+    }
+
+private:
+    struct ParallelForState {
+        std::function<void(int, int)> fn;
+        int count = 0;
+        int grain = 1;
+        int ranges = 0;
+        std::atomic<int> next{ 0 };
+        int completed = 0;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+
+    static void runRanges(ParallelForState& state)
+    {
+        for (;;) {
+            int range = state.next.fetch_add(1);
+            if (range >= state.ranges) return;
+
+            int begin = range * state.grain;
+            int end = std::min(begin + state.grain, state.count);
+            state.fn(begin, end);
+
+            std::lock_guard<std::mutex> lock(state.mutex);
+            if (++state.completed == state.ranges) state.finished.notify_all();
+        }
+    }
+
+    void workerLoop()
+    {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
+
+// Pool shared by the terrain generator, one worker per hardware thread
+ThreadPool& sharedThreadPool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+#endif